@@ -0,0 +1,265 @@
+// Headless benchmark for the batched Jolt scene queries
+// Builds a scene of static and dynamic boxes and spheres, then runs the same rays, sphere casts and
+// box overlaps one by one on the calling thread and as batches on the job system, and prints how
+// many queries a second each manages. The scene and the queries come from a fixed seed, and the
+// batched results are checked against the one by one results
+//
+// Usage: jolt_query_bench [--bodies N] [--queries N] [--repeats N] [--threads N]
+// The defaults are 10k bodies and batches of 1k queries, repeated 20 times
+
+#include <salmon/physics.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+const float WORLD_SIZE = 200.0f; // The bodies are spread over a square this wide
+
+struct Options
+{
+    int bodies = 10000;
+    int queries = 1000;
+    int repeats = 20;
+    int threads = (int)std::thread::hardware_concurrency() - 1;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BuildScene(const Options& options, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f);
+    std::uniform_real_distribution<float> height(0.5f, 20.0f);
+    std::uniform_real_distribution<float> size(0.3f, 1.5f);
+
+    JPH::Body* ground = bodyInterface.CreateBody(JPH::BodyCreationSettings(
+        GetBoxShape(JPH::Vec3(WORLD_SIZE, 0.5f, WORLD_SIZE)), JPH::RVec3(0.0f, -0.5f, 0.0f),
+        JPH::Quat::sIdentity(), JPH::EMotionType::Static, Layers::NON_MOVING));
+    QueueBodyAdd(ground);
+
+    for (int i = 1; i < options.bodies; ++i)
+    {
+        bool isStatic = i % 2 == 0;
+
+        JPH::ShapeRefC shape = i % 3 == 0 ? GetSphereShape(size(random))
+                                          : GetBoxShape(JPH::Vec3(size(random), size(random),
+                                                                  size(random)));
+
+        JPH::BodyCreationSettings settings(
+            shape, JPH::RVec3(position(random), height(random), position(random)),
+            JPH::Quat::sIdentity(), isStatic ? JPH::EMotionType::Static : JPH::EMotionType::Dynamic,
+            isStatic ? Layers::NON_MOVING : Layers::MOVING);
+
+        JPH::Body* body = bodyInterface.CreateBody(settings);
+        if (body == nullptr)
+        {
+            std::fprintf(stderr, "Ran out of bodies at %d\n", i);
+            break;
+        }
+
+        QueueBodyAdd(body);
+    }
+
+    AddPendingBodies(true);
+}
+
+// Line of sight checks between random points, a quarter of them only against moving bodies
+void MakeQueries(const Options& options, std::mt19937& random, std::vector<RaycastQuery>& rays,
+                 std::vector<SphereCastQuery>& spheres, std::vector<OverlapBoxQuery>& boxes)
+{
+    std::uniform_real_distribution<float> position(-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f);
+    std::uniform_real_distribution<float> height(1.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.5f, 3.0f);
+
+    for (int i = 0; i < options.queries; ++i)
+    {
+        JPH::RVec3 from(position(random), height(random), position(random));
+        JPH::RVec3 to(position(random), height(random), position(random));
+        uint32_t   layerMask = i % 4 == 0 ? LayerBit(Layers::MOVING) : cAllLayers;
+
+        rays.push_back(RaycastQuery(from, JPH::Vec3(to - from), layerMask));
+        spheres.push_back(SphereCastQuery(from, JPH::Vec3(to - from), 0.25f, layerMask));
+        boxes.push_back(OverlapBoxQuery(from, JPH::Vec3(size(random), size(random), size(random)),
+                                        JPH::Quat::sIdentity(), layerMask));
+    }
+}
+
+// Runs the batch with one query per call so everything happens on this thread
+template <typename Query, typename Batch> double RunOneByOne(const std::vector<Query>& queries,
+                                                             int repeats, Batch batch)
+{
+    std::vector<Query> single(1);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        for (const Query& query : queries)
+        {
+            single[0] = query;
+            batch(single);
+        }
+    }
+
+    return (double)queries.size() * repeats / SecondsSince(start);
+}
+
+template <typename Query, typename Batch> double RunBatched(const std::vector<Query>& queries,
+                                                            int repeats, Batch batch)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        batch(queries);
+    }
+
+    return (double)queries.size() * repeats / SecondsSince(start);
+}
+
+void Report(const char* name, double oneByOne, double batched, int hits, int mismatches)
+{
+    std::printf("%-12s %12.0f %12.0f %8.2fx %8d %10d\n", name, oneByOne, batched,
+                batched / oneByOne, hits, mismatches);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--bodies") == 0)
+            options.bodies = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--queries") == 0)
+            options.queries = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--repeats") == 0)
+            options.repeats = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--threads") == 0)
+            options.threads = std::atoi(argv[i + 1]);
+    }
+
+    JPH::RegisterDefaultAllocator();
+    JPH::Factory::sInstance = new JPH::Factory();
+    JPH::RegisterTypes();
+
+    // Its own job system rather than the engine's so --threads decides how many workers there are
+    EngineJobSystem benchJobSystem(std::max(options.threads, 0));
+
+    tempAllocator = new TrackingTempAllocator(10 * 1024 * 1024);
+    jobSystem = &benchJobSystem;
+
+    BPLayerInterfaceImpl              broadPhaseLayerInterface;
+    ObjectVsBroadPhaseLayerFilterImpl objectVsBroadphaseLayerFilter;
+    ObjectLayerPairFilterImpl         objectVsObjectLayerFilter;
+    physicsSystem.Init(std::max(cMaxBodies, (unsigned int)options.bodies), cNumBodyMutexes,
+                       cMaxBodyPairs, cMaxContactConstraints, broadPhaseLayerInterface,
+                       objectVsBroadphaseLayerFilter, objectVsObjectLayerFilter);
+
+    std::mt19937 random(1234);
+    BuildScene(options, random);
+
+    std::vector<RaycastQuery>    rays;
+    std::vector<SphereCastQuery> spheres;
+    std::vector<OverlapBoxQuery> boxes;
+    MakeQueries(options, random, rays, spheres, boxes);
+
+    std::printf("%u bodies, %d queries per batch, %d worker threads\n",
+                physicsSystem.GetNumBodies(), options.queries, options.threads);
+    std::printf("%-12s %12s %12s %9s %8s %10s\n", "query", "single q/s", "batched q/s", "speedup",
+                "hits", "mismatches");
+
+    // Rays
+    {
+        std::vector<QueryHit> hits;
+        std::vector<QueryHit> singleHits;
+        std::vector<QueryHit> singleHit;
+
+        double oneByOne = RunOneByOne(rays, options.repeats,
+                                      [&](const std::vector<RaycastQuery>& batch)
+                                      {
+                                          RaycastBatch(batch, singleHit);
+                                          singleHits.push_back(singleHit[0]);
+                                      });
+        double batched = RunBatched(rays, options.repeats,
+                                    [&](const std::vector<RaycastQuery>& batch)
+                                    { RaycastBatch(batch, hits); });
+
+        int hitCount = 0;
+        int mismatches = 0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            hitCount += !hits[i].body.IsInvalid();
+            mismatches += hits[i].body != singleHits[i].body;
+        }
+
+        Report("raycast", oneByOne, batched, hitCount, mismatches);
+    }
+
+    // Sphere casts
+    {
+        std::vector<QueryHit> hits;
+        std::vector<QueryHit> singleHits;
+        std::vector<QueryHit> singleHit;
+
+        double oneByOne = RunOneByOne(spheres, options.repeats,
+                                      [&](const std::vector<SphereCastQuery>& batch)
+                                      {
+                                          SphereCastBatch(batch, singleHit);
+                                          singleHits.push_back(singleHit[0]);
+                                      });
+        double batched = RunBatched(spheres, options.repeats,
+                                    [&](const std::vector<SphereCastQuery>& batch)
+                                    { SphereCastBatch(batch, hits); });
+
+        int hitCount = 0;
+        int mismatches = 0;
+        for (size_t i = 0; i < spheres.size(); ++i)
+        {
+            hitCount += !hits[i].body.IsInvalid();
+            mismatches += hits[i].body != singleHits[i].body;
+        }
+
+        Report("spherecast", oneByOne, batched, hitCount, mismatches);
+    }
+
+    // Box overlaps
+    {
+        const int                maxBodies = 16;
+        std::vector<JPH::BodyID> bodies;
+        std::vector<int>         counts;
+        std::vector<JPH::BodyID> singleBodies;
+        std::vector<int>         singleCounts;
+        std::vector<int>         allSingleCounts;
+
+        double oneByOne = RunOneByOne(boxes, options.repeats,
+                                      [&](const std::vector<OverlapBoxQuery>& batch)
+                                      {
+                                          OverlapBoxBatch(batch, maxBodies, singleBodies,
+                                                          singleCounts);
+                                          allSingleCounts.push_back(singleCounts[0]);
+                                      });
+        double batched = RunBatched(boxes, options.repeats,
+                                    [&](const std::vector<OverlapBoxQuery>& batch)
+                                    { OverlapBoxBatch(batch, maxBodies, bodies, counts); });
+
+        int hitCount = 0;
+        int mismatches = 0;
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            hitCount += counts[i] > 0;
+            mismatches += counts[i] != allSingleCounts[i];
+        }
+
+        Report("overlap box", oneByOne, batched, hitCount, mismatches);
+    }
+
+    DestroyPhysics();
+    return 0;
+}
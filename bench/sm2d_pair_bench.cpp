@@ -0,0 +1,127 @@
+// Microbenchmark for the sm2d polygon narrowphase
+// Runs TestColPolygonPolygon and TestColAABBPolygon over a fixed set of overlapping pairs and
+// prints how many pair tests per second each of them manages with every SAT kernel the CPU has
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/functions.h>
+#include <sm2d/sat.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+
+namespace
+{
+
+const int PAIR_COUNT = 4096;
+
+struct Body
+{
+    Transform       transform;
+    sm2d::Rigidbody rigidbody;
+};
+
+// Makes a convex polygon by walking around a circle at random angles
+sm2d::ColPolygon MakePolygon(std::mt19937& rng, int vertexCount, float radius)
+{
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    sm2d::ColPolygon poly;
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        // Clockwise, the same winding the rest of the engine uses
+        float angle = -2.0f * SM_PI * ((float)i + jitter(rng)) / (float)vertexCount;
+        poly.points.push_back(glm::vec2(std::cos(angle), std::sin(angle)) * radius);
+    }
+    return poly;
+}
+
+template<typename Test>
+double PairTestsPerSecond(std::deque<sm2d::Collider>& a, std::deque<sm2d::Collider>& b,
+                          int rounds, Test test, int& collisions)
+{
+    collisions = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (int i = 0; i < PAIR_COUNT; ++i)
+        {
+            collisions += test(a[i], b[i]).colliding ? 1 : 0;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return (double)rounds * PAIR_COUNT / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // The engine headers pull in Jolt, which needs its allocator even if it's never used
+    JPH::RegisterDefaultAllocator();
+
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    std::mt19937                          rng(1234);
+    std::uniform_real_distribution<float> offset(-0.9f, 0.9f);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * SM_PI);
+    std::uniform_int_distribution<int>    vertexCount(3, 8);
+
+    std::vector<Body> bodies(PAIR_COUNT * 3);
+    for (int i = 0; i < (int)bodies.size(); ++i)
+    {
+        Body& body = bodies[i];
+        body.transform.position = glm::vec3(i % 3 == 0 ? 0.0f : offset(rng), offset(rng), 0.0f);
+        body.transform.rotation = glm::vec3(0.0f, 0.0f, i % 3 == 2 ? 0.0f : angle(rng));
+        body.rigidbody.type = sm2d::sm2d_Dynamic;
+        body.rigidbody.transform = &body.transform;
+        body.rigidbody.mass = 1.0f;
+        body.rigidbody.awake = true;
+        body.rigidbody.momentOfInertia = 1.0f;
+    }
+
+    // Colliders can't be copied or moved because of the shape union, a deque never moves them
+    std::deque<sm2d::Collider> polygonsA, polygonsB, boxes;
+    for (int i = 0; i < PAIR_COUNT; ++i)
+    {
+        polygonsA.emplace_back(sm2d::sm2d_Polygon, MakePolygon(rng, vertexCount(rng), 0.6f),
+                               &bodies[i * 3].rigidbody);
+        polygonsB.emplace_back(sm2d::sm2d_Polygon, MakePolygon(rng, vertexCount(rng), 0.6f),
+                               &bodies[i * 3 + 1].rigidbody);
+        boxes.emplace_back(sm2d::sm2d_AABB, sm2d::ColAABB(glm::vec2(0.5f, 0.4f)),
+                           &bodies[i * 3 + 2].rigidbody);
+    }
+
+    for (std::deque<sm2d::Collider>* polygons : {&polygonsA, &polygonsB})
+    {
+        for (sm2d::Collider& poly : *polygons)
+        {
+            sm2d::SyncCollider(poly);
+        }
+    }
+
+    const char* kernelNames[] = {"scalar", "SSE", "AVX"};
+
+    for (int kernel = sm2d::sm2d_SATScalar; kernel <= sm2d::GetBestSATKernel(); ++kernel)
+    {
+        sm2d::SetSATKernel((sm2d::SATKernel)kernel);
+
+        int    collisions = 0;
+        double rate = PairTestsPerSecond(polygonsA, polygonsB, rounds, sm2d::TestColPolygonPolygon,
+                                         collisions);
+        std::printf("[%-6s] TestColPolygonPolygon: %12.0f pair tests/s "
+                    "(%d of %d pairs colliding)\n",
+                    kernelNames[kernel], rate, collisions / rounds, PAIR_COUNT);
+
+        rate = PairTestsPerSecond(boxes, polygonsB, rounds, sm2d::TestColAABBPolygon, collisions);
+        std::printf("[%-6s] TestColAABBPolygon:    %12.0f pair tests/s "
+                    "(%d of %d pairs colliding)\n",
+                    kernelNames[kernel], rate, collisions / rounds, PAIR_COUNT);
+    }
+
+    return 0;
+}
@@ -0,0 +1,592 @@
+// Headless scenario benchmark for sm2d
+// Steps a set of standard scenes through the same phases as the engine's frame and writes a JSON
+// report with the time each phase took per step, how many pairs and contacts there were, and a
+// hash of the final body states. The hash only changes when the simulation does, so reports from
+// two commits can be diffed to tell a speedup from a behavior change. The scenes are built from a
+// fixed seed, the hash is only comparable between builds made with the same standard library
+//
+// Usage: sm2d_scenario_bench [--steps N] [--scale F] [--solver impulse|soft] [--scenario NAME]
+//                            [--out FILE]
+// --scale multiplies the size of every scene, the full sizes are a 1k box pyramid, 10k circles,
+// a 2k polygon pile, a 10k tile field, 1k bullets and 2k circles falling through 100 sensors. The
+// tile field is also run with its tiles merged into chains and into rectangles
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/continuous.h>
+#include <sm2d/functions.h>
+#include <sm2d/solver.h>
+#include <sm2d/thread_pool.h>
+#include <sm2d/tiles.h>
+#include <sm2d/world.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const float TIME_STEP = 1.0f / 60.0f;
+
+const uint32_t BULLET_CATEGORY = 0x0002u;
+
+struct Body
+{
+    Transform       transform;
+    sm2d::Rigidbody rigidbody;
+};
+
+struct Scenario
+{
+    sm2d::World world;
+
+    // Neither bodies nor colliders can move once the world points at them
+    std::deque<Body>           bodies;
+    std::deque<sm2d::Collider> colliders;
+};
+
+// Milliseconds spent in each phase over the whole run
+struct PhaseTimes
+{
+    double integrate = 0.0; // Zero with the soft step solver, it integrates inside the solve
+    double broadphase = 0.0;
+    double continuous = 0.0;
+    double narrowphase = 0.0;
+    double solve = 0.0;
+    double islands = 0.0;
+};
+
+struct Counters
+{
+    size_t pairs = 0;
+    size_t contacts = 0;
+    size_t contactPoints = 0;
+    size_t sensorEvents = 0;
+};
+
+class Stopwatch
+{
+  public:
+    Stopwatch() : last(std::chrono::steady_clock::now()) {}
+
+    // Returns the milliseconds since the last lap
+    double Lap()
+    {
+        auto                                      now = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> elapsed = now - last;
+        last = now;
+        return elapsed.count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point last;
+};
+
+sm2d::Rigidbody& CreateBody(Scenario& scenario, const glm::vec2& position, sm2d::BodyType type)
+{
+    Body& body = scenario.bodies.emplace_back();
+    body.transform.position = glm::vec3(position, 0.0f);
+    body.transform.rotation = glm::vec3(0.0f);
+    body.transform.scale = glm::vec3(1.0f);
+
+    body.rigidbody.type = type;
+    body.rigidbody.transform = &body.transform;
+    body.rigidbody.mass = 1.0f;
+    body.rigidbody.awake = true;
+    body.rigidbody.linearDamping = 1.0f;
+    body.rigidbody.angularDamping = 1.0f;
+    body.rigidbody.momentOfInertia = 1.0f;
+    return body.rigidbody;
+}
+
+sm2d::Collider& AddCollider(Scenario& scenario, sm2d::Collider& collider)
+{
+    sm2d::AddCollider(scenario.world, &collider);
+    return collider;
+}
+
+sm2d::Collider& AddPolygon(Scenario& scenario, const glm::vec2& position,
+                           const std::vector<glm::vec2>& points, sm2d::BodyType type)
+{
+    sm2d::Rigidbody& body = CreateBody(scenario, position, type);
+
+    sm2d::ColPolygon polygon;
+    polygon.points = points;
+    sm2d::Collider& collider = scenario.colliders.emplace_back(sm2d::sm2d_Polygon, polygon, &body);
+
+    // Unit density, so the mass is the area
+    body.mass = collider.polygon.area;
+    body.momentOfInertia = collider.polygon.inertia;
+    return AddCollider(scenario, collider);
+}
+
+sm2d::Collider& AddBox(Scenario& scenario, const glm::vec2& position, float halfWidth,
+                       float halfHeight, sm2d::BodyType type)
+{
+    // Clockwise, the same winding the rest of the engine uses
+    return AddPolygon(scenario, position,
+                      {glm::vec2(-halfWidth, -halfHeight), glm::vec2(-halfWidth, halfHeight),
+                       glm::vec2(halfWidth, halfHeight), glm::vec2(halfWidth, -halfHeight)},
+                      type);
+}
+
+sm2d::Collider& AddTile(Scenario& scenario, const glm::vec2& position, float halfWidth,
+                        float halfHeight, sm2d::BodyType type)
+{
+    sm2d::Rigidbody& body = CreateBody(scenario, position, type);
+    body.fixedRotation = true;
+
+    sm2d::Collider& collider = scenario.colliders.emplace_back(
+        sm2d::sm2d_AABB, sm2d::ColAABB{glm::vec2(halfWidth, halfHeight)}, &body);
+    return AddCollider(scenario, collider);
+}
+
+sm2d::Collider& AddCircle(Scenario& scenario, const glm::vec2& position, float radius)
+{
+    sm2d::Rigidbody& body = CreateBody(scenario, position, sm2d::sm2d_Dynamic);
+    body.momentOfInertia = 0.5f * radius * radius;
+
+    sm2d::Collider& collider =
+        scenario.colliders.emplace_back(sm2d::sm2d_Circle, sm2d::ColCircle{radius}, &body);
+    return AddCollider(scenario, collider);
+}
+
+int Scaled(int count, float scale)
+{
+    return std::max((int)std::lround(count * scale), 1);
+}
+
+void BuildPyramid(Scenario& scenario, float scale)
+{
+    // The largest pyramid with no more than the asked for number of boxes
+    int boxes = Scaled(1000, scale);
+    int rows = (int)((std::sqrt(8.0 * boxes + 1.0) - 1.0) / 2.0);
+
+    AddBox(scenario, glm::vec2(0.0f, -0.5f), 0.6f * rows + 10.0f, 0.5f, sm2d::sm2d_Static);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        int count = rows - row;
+        for (int i = 0; i < count; ++i)
+        {
+            float x = (float)i - 0.5f * (float)(count - 1);
+            AddBox(scenario, glm::vec2(x, 0.5f + (float)row), 0.5f, 0.5f, sm2d::sm2d_Dynamic);
+        }
+    }
+}
+
+void BuildCircles(Scenario& scenario, float scale)
+{
+    std::mt19937                          rng(37);
+    std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+
+    int   circles = Scaled(10000, scale);
+    int   columns = 100;
+    float halfWidth = 0.5f * columns;
+
+    AddTile(scenario, glm::vec2(0.0f, -0.5f), halfWidth + 1.0f, 0.5f, sm2d::sm2d_Static);
+    AddTile(scenario, glm::vec2(-halfWidth - 0.5f, 50.0f), 0.5f, 50.0f, sm2d::sm2d_Static);
+    AddTile(scenario, glm::vec2(halfWidth + 0.5f, 50.0f), 0.5f, 50.0f, sm2d::sm2d_Static);
+
+    for (int i = 0; i < circles; ++i)
+    {
+        float x = -halfWidth + 0.5f + (float)(i % columns) + jitter(rng);
+        float y = 1.0f + 0.6f * (float)(i / columns);
+        AddCircle(scenario, glm::vec2(x, y), 0.25f);
+    }
+}
+
+void BuildPolygonPile(Scenario& scenario, float scale)
+{
+    std::mt19937                          rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int>    vertexCount(3, SM_MAX_POLYGON_VERTICES);
+
+    int   shapes = Scaled(2000, scale);
+    int   columns = 40;
+    float halfWidth = 0.75f * columns;
+
+    AddBox(scenario, glm::vec2(0.0f, -0.5f), halfWidth + 1.0f, 0.5f, sm2d::sm2d_Static);
+    AddBox(scenario, glm::vec2(-halfWidth - 0.5f, 40.0f), 0.5f, 40.0f, sm2d::sm2d_Static);
+    AddBox(scenario, glm::vec2(halfWidth + 0.5f, 40.0f), 0.5f, 40.0f, sm2d::sm2d_Static);
+
+    for (int i = 0; i < shapes; ++i)
+    {
+        glm::vec2 position = glm::vec2(-halfWidth + 0.75f + 1.5f * (float)(i % columns),
+                                       1.0f + 1.5f * (float)(i / columns));
+
+        // Every fourth shape is an axis aligned box, the rest are random convex polygons
+        if (i % 4 == 3)
+        {
+            AddTile(scenario, position, 0.3f + 0.3f * unit(rng), 0.3f + 0.3f * unit(rng),
+                    sm2d::sm2d_Dynamic);
+            continue;
+        }
+
+        int                    count = vertexCount(rng);
+        float                  radius = 0.3f + 0.35f * unit(rng);
+        std::vector<glm::vec2> points;
+        for (int j = 0; j < count; ++j)
+        {
+            float angle = -2.0f * SM_PI * ((float)j + 0.3f * unit(rng)) / (float)count;
+            points.push_back(radius * glm::vec2(std::cos(angle), std::sin(angle)));
+        }
+        AddPolygon(scenario, position, points, sm2d::sm2d_Dynamic);
+    }
+}
+
+const int TILE_FIELD_COLUMNS = 200;
+
+void DropTileFieldBoxes(Scenario& scenario, float scale)
+{
+    int boxes = Scaled(500, scale);
+
+    for (int i = 0; i < boxes; ++i)
+    {
+        glm::vec2 position = glm::vec2(-0.5f * TILE_FIELD_COLUMNS + 1.0f + 2.0f * (float)(i % 90),
+                                       2.0f + 2.0f * (float)(i / 90));
+        AddTile(scenario, position, 0.4f, 0.4f, sm2d::sm2d_Dynamic);
+    }
+}
+
+void BuildTileField(Scenario& scenario, float scale)
+{
+    int columns = TILE_FIELD_COLUMNS;
+    int rows = Scaled(50, scale);
+
+    // A solid block of tiles like a tile map would make, the top row is the floor
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            AddTile(scenario, glm::vec2((float)column - 0.5f * columns, -0.5f - (float)row), 0.5f,
+                    0.5f, sm2d::sm2d_Static);
+        }
+    }
+
+    DropTileFieldBoxes(scenario, scale);
+}
+
+// The tiles of the tile field as a grid, the top of the block is at zero like in the tile field
+sm2d::TileGrid MakeTileFieldGrid(std::vector<uint8_t>& solid, float scale)
+{
+    sm2d::TileGrid grid;
+    grid.width = TILE_FIELD_COLUMNS;
+    grid.height = Scaled(50, scale);
+    grid.origin = glm::vec2(-0.5f * grid.width - 0.5f, -(float)grid.height);
+
+    solid.assign(grid.width * grid.height, 1);
+    grid.solid = solid.data();
+    return grid;
+}
+
+void BuildTileChains(Scenario& scenario, float scale)
+{
+    std::vector<uint8_t> solid;
+    sm2d::TileGrid       grid = MakeTileFieldGrid(solid, scale);
+
+    std::vector<std::vector<glm::vec2>> chains;
+    sm2d::MergeTilesIntoChains(grid, chains);
+
+    // Every chain goes on the same static body at the origin
+    sm2d::Rigidbody& body = CreateBody(scenario, glm::vec2(0.0f), sm2d::sm2d_Static);
+    for (const std::vector<glm::vec2>& points : chains)
+    {
+        sm2d::ColChain chain;
+        chain.points = points;
+        chain.loop = true;
+        AddCollider(scenario, scenario.colliders.emplace_back(sm2d::sm2d_Chain, chain, &body));
+    }
+
+    DropTileFieldBoxes(scenario, scale);
+}
+
+void BuildTileRectangles(Scenario& scenario, float scale)
+{
+    std::vector<uint8_t> solid;
+    sm2d::TileGrid       grid = MakeTileFieldGrid(solid, scale);
+
+    std::vector<sm2d::AABB> rectangles;
+    sm2d::MergeTilesIntoRectangles(grid, rectangles);
+
+    for (const sm2d::AABB& rectangle : rectangles)
+    {
+        glm::vec2 halfwidths = 0.5f * (rectangle.upperBound - rectangle.lowerBound);
+        AddTile(scenario, sm2d::AABBCenter(rectangle), halfwidths.x, halfwidths.y,
+                sm2d::sm2d_Static);
+    }
+
+    DropTileFieldBoxes(scenario, scale);
+}
+
+void BuildSensors(Scenario& scenario, float scale)
+{
+    int circles = Scaled(2000, scale);
+    int columns = 100;
+
+    AddTile(scenario, glm::vec2(0.0f, -0.5f), 0.5f * columns + 1.0f, 0.5f, sm2d::sm2d_Static);
+
+    // Large overlapping trigger volumes the circles fall through before they land
+    for (int i = 0; i < 100; ++i)
+    {
+        glm::vec2 position = glm::vec2(-0.5f * columns + 5.0f * (float)(i % 20) + 2.5f,
+                                       10.0f + 8.0f * (float)(i / 20));
+        AddTile(scenario, position, 4.0f, 6.0f, sm2d::sm2d_Static).sensor = true;
+    }
+
+    for (int i = 0; i < circles; ++i)
+    {
+        glm::vec2 position =
+            glm::vec2(-0.5f * columns + 0.5f + (float)(i % columns), 60.0f + (float)(i / columns));
+        AddCircle(scenario, position, 0.25f);
+    }
+}
+
+void BuildBullets(Scenario& scenario, float scale)
+{
+    int bullets = Scaled(1000, scale);
+    int rows = 50;
+
+    AddTile(scenario, glm::vec2(20.0f, -1.0f), 40.0f, 0.5f, sm2d::sm2d_Static);
+    for (int i = 0; i < 4; ++i)
+    {
+        AddTile(scenario, glm::vec2(15.0f + 10.0f * (float)i, 25.0f), 0.1f, 25.0f,
+                sm2d::sm2d_Static);
+    }
+
+    // Fast enough to cross a wall several times over in one step, they don't hit each other
+    for (int i = 0; i < bullets; ++i)
+    {
+        glm::vec2 position = glm::vec2(-(float)(i / rows), 0.5f + (float)(i % rows));
+
+        sm2d::Collider& collider = AddTile(scenario, position, 0.1f, 0.1f, sm2d::sm2d_Dynamic);
+        collider.body->bullet = true;
+        sm2d::SetLinearVelocity(collider.body, glm::vec2(300.0f + (float)(i % 7) * 20.0f, 0.0f));
+
+        sm2d::Filter filter;
+        filter.categoryBits = BULLET_CATEGORY;
+        filter.maskBits = ~BULLET_CATEGORY;
+        sm2d::SetFilter(scenario.world, collider, filter);
+    }
+}
+
+// StepWorld, split up so each phase gets timed on its own
+void Step(Scenario& scenario, PhaseTimes& times, Counters& counters)
+{
+    sm2d::World& world = scenario.world;
+    Stopwatch    stopwatch;
+
+    if (world.settings.solverType != sm2d::sm2d_SolverSoftStep)
+    {
+        sm2d::LoadBodies(world, TIME_STEP);
+        sm2d::IntegrateBodies(world);
+        sm2d::StoreBodies(world);
+    }
+    times.integrate += stopwatch.Lap();
+
+    sm2d::UpdateColliders(world);
+    times.broadphase += stopwatch.Lap();
+
+    sm2d::SolveBullets(world);
+    times.continuous += stopwatch.Lap();
+
+    // GetCollisionsInWorld, split so the pair search and the narrowphase are timed on their own
+    world.pairs.clear();
+    sm2d::GetPairsInTree(world.dynamicTree, world.staticTree, world.pairs);
+    times.broadphase += stopwatch.Lap();
+
+    world.contacts.clear();
+    sm2d::CollidePairs(world, world.pairs, world.contacts);
+    times.narrowphase += stopwatch.Lap();
+
+    sm2d::SolveContacts(world, TIME_STEP);
+    times.solve += stopwatch.Lap();
+
+    sm2d::UpdateIslands(world, TIME_STEP);
+    times.islands += stopwatch.Lap();
+
+    counters.pairs += world.pairs.size();
+    counters.contacts += world.contacts.size();
+    for (const sm2d::Manifold& manifold : world.contacts)
+    {
+        counters.contactPoints += manifold.pointCount;
+    }
+    counters.sensorEvents += world.sensorBeginEvents.size() + world.sensorEndEvents.size();
+}
+
+// FNV-1a over the bits of every position and rotation, in the order the bodies were made
+uint64_t HashBodies(const Scenario& scenario)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const Body& body : scenario.bodies)
+    {
+        float state[3] = {body.transform.position.x, body.transform.position.y,
+                          body.transform.rotation.z};
+        unsigned char bytes[sizeof(state)];
+        std::memcpy(bytes, state, sizeof(state));
+        for (unsigned char byte : bytes)
+        {
+            hash = (hash ^ byte) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+struct ScenarioDefinition
+{
+    const char* name;
+    void (*build)(Scenario& scenario, float scale);
+};
+
+const ScenarioDefinition SCENARIOS[] = {
+    {"pyramid", BuildPyramid},
+    {"circles", BuildCircles},
+    {"polygonPile", BuildPolygonPile},
+    {"tileField", BuildTileField},
+    {"tileChains", BuildTileChains},
+    {"tileRectangles", BuildTileRectangles},
+    {"bullets", BuildBullets},
+    {"sensors", BuildSensors},
+};
+
+std::string RunScenario(const ScenarioDefinition& definition, int steps, float scale,
+                        sm2d::SolverType solver)
+{
+    // Every scenario gets a world of its own
+    Scenario scenario;
+    scenario.world.settings.solverType = solver;
+    definition.build(scenario, scale);
+
+    // Builds the static tree before the clock starts
+    sm2d::UpdateColliders(scenario.world);
+
+    int dynamicBodies = 0;
+    for (const Body& body : scenario.bodies)
+    {
+        dynamicBodies += body.rigidbody.type == sm2d::sm2d_Dynamic ? 1 : 0;
+    }
+
+    // Leaves in the static tree, every segment of a chain is one
+    int staticColliders = 0;
+    for (const sm2d::Collider* collider : scenario.world.colliders)
+    {
+        staticColliders += collider->body->type == sm2d::sm2d_Static ? 1 : 0;
+    }
+
+    PhaseTimes times;
+    Counters   counters;
+
+    std::fprintf(stderr, "%s: %zu bodies, %d steps\n", definition.name, scenario.bodies.size(),
+                 steps);
+
+    Stopwatch total;
+    for (int i = 0; i < steps; ++i)
+    {
+        Step(scenario, times, counters);
+    }
+    double totalTime = total.Lap();
+
+    char json[1024];
+    std::snprintf(
+        json, sizeof(json),
+        "    {\n"
+        "      \"name\": \"%s\",\n"
+        "      \"bodies\": %zu,\n"
+        "      \"dynamicBodies\": %d,\n"
+        "      \"staticColliders\": %d,\n"
+        "      \"msPerStep\": {\"total\": %.4f, \"integrate\": %.4f, \"broadphase\": %.4f, "
+        "\"continuous\": %.4f, \"narrowphase\": %.4f, \"solve\": %.4f, \"islands\": %.4f},\n"
+        "      \"pairsPerStep\": %.1f,\n"
+        "      \"contactsPerStep\": %.1f,\n"
+        "      \"contactPointsPerStep\": %.1f,\n"
+        "      \"sensorEventsPerStep\": %.1f,\n"
+        "      \"hash\": \"%016llx\"\n"
+        "    }",
+        definition.name, scenario.bodies.size(), dynamicBodies, staticColliders, totalTime / steps,
+        times.integrate / steps, times.broadphase / steps, times.continuous / steps,
+        times.narrowphase / steps, times.solve / steps, times.islands / steps,
+        (double)counters.pairs / steps, (double)counters.contacts / steps,
+        (double)counters.contactPoints / steps, (double)counters.sensorEvents / steps,
+        (unsigned long long)HashBodies(scenario));
+    return json;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // The engine headers pull in Jolt, which needs its allocator even if it's never used
+    JPH::RegisterDefaultAllocator();
+
+    int              steps = 300;
+    float            scale = 1.0f;
+    sm2d::SolverType solver = sm2d::WorldSettings().solverType;
+    const char*      only = nullptr;
+    const char*      outPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--steps") == 0)
+            steps = std::max(std::atoi(argv[i + 1]), 1);
+        else if (std::strcmp(argv[i], "--scale") == 0)
+            scale = (float)std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--solver") == 0)
+            solver = std::strcmp(argv[i + 1], "soft") == 0 ? sm2d::sm2d_SolverSoftStep
+                                                           : sm2d::sm2d_SolverImpulse;
+        else if (std::strcmp(argv[i], "--scenario") == 0)
+            only = argv[i + 1];
+        else if (std::strcmp(argv[i], "--out") == 0)
+            outPath = argv[i + 1];
+        else
+        {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::string report = "{\n";
+    report += "  \"steps\": " + std::to_string(steps) + ",\n";
+    report += "  \"scale\": " + std::to_string(scale) + ",\n";
+    report += std::string("  \"solver\": \"") +
+              (solver == sm2d::sm2d_SolverSoftStep ? "soft" : "impulse") + "\",\n";
+    report += "  \"workers\": " + std::to_string(sm2d::GetThreadPool().GetWorkerCount()) + ",\n";
+    report += "  \"scenarios\": [\n";
+
+    bool first = true;
+    for (const ScenarioDefinition& definition : SCENARIOS)
+    {
+        if (only != nullptr && std::strcmp(only, definition.name) != 0)
+            continue;
+
+        if (!first)
+            report += ",\n";
+        report += RunScenario(definition, steps, scale, solver);
+        first = false;
+    }
+
+    report += "\n  ]\n}\n";
+
+    if (outPath != nullptr)
+    {
+        FILE* file = std::fopen(outPath, "w");
+        if (file == nullptr)
+        {
+            std::fprintf(stderr, "Couldn't open %s\n", outPath);
+            return 1;
+        }
+        std::fputs(report.c_str(), file);
+        std::fclose(file);
+    }
+    else
+    {
+        std::fputs(report.c_str(), stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Benchmark for the sm2d contact solvers
+// Builds a pyramid and a tower of boxes on a static ground and steps them with ResolveCollisions
+// and with the soft step solver. Prints the time per step and how far the boxes drifted from where
+// they started, a stable stack should barely move. Islands are never updated, so nothing falls
+// asleep and every step does the full amount of work. The hash of the final positions should be
+// the same on every run
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/functions.h>
+#include <sm2d/solver.h>
+#include <sm2d/world.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace
+{
+
+const float TIME_STEP = 1.0f / 60.0f;
+
+struct Body
+{
+    Transform       transform;
+    sm2d::Rigidbody rigidbody;
+};
+
+struct Stack
+{
+    sm2d::World world;
+
+    // Neither bodies nor colliders can move once the world points at them
+    std::deque<Body>           bodies;
+    std::deque<sm2d::Collider> colliders;
+    std::vector<glm::vec2>     startPositions;
+};
+
+sm2d::ColPolygon MakeBox(float halfWidth, float halfHeight)
+{
+    sm2d::ColPolygon box;
+    box.points = {glm::vec2(-halfWidth, -halfHeight), glm::vec2(-halfWidth, halfHeight),
+                  glm::vec2(halfWidth, halfHeight), glm::vec2(halfWidth, -halfHeight)};
+    return box;
+}
+
+void AddBox(Stack& scene, const glm::vec2& position, float halfWidth, float halfHeight,
+            sm2d::BodyType type)
+{
+    Body& body = scene.bodies.emplace_back();
+    body.transform.position = glm::vec3(position, 0.0f);
+    body.transform.rotation = glm::vec3(0.0f);
+    body.transform.scale = glm::vec3(1.0f);
+
+    float mass = 1.0f;
+    body.rigidbody.type = type;
+    body.rigidbody.transform = &body.transform;
+    body.rigidbody.mass = mass;
+    body.rigidbody.awake = true;
+    body.rigidbody.linearDamping = 1.0f;
+    body.rigidbody.angularDamping = 1.0f;
+    body.rigidbody.momentOfInertia =
+        mass * (4.0f * halfWidth * halfWidth + 4.0f * halfHeight * halfHeight) / 12.0f;
+
+    sm2d::Collider& collider = scene.colliders.emplace_back(
+        sm2d::sm2d_Polygon, MakeBox(halfWidth, halfHeight), &body.rigidbody);
+    sm2d::AddCollider(scene.world, &collider);
+
+    scene.startPositions.push_back(position);
+}
+
+void AddGround(Stack& scene)
+{
+    AddBox(scene, glm::vec2(0.0f, -0.5f), 40.0f, 0.5f, sm2d::sm2d_Static);
+}
+
+void BuildPyramid(Stack& scene, int rows)
+{
+    AddGround(scene);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        int boxes = rows - row;
+        for (int i = 0; i < boxes; ++i)
+        {
+            float x = (float)i - 0.5f * (float)(boxes - 1);
+            AddBox(scene, glm::vec2(x, 0.5f + (float)row), 0.5f, 0.5f, sm2d::sm2d_Dynamic);
+        }
+    }
+}
+
+void BuildTower(Stack& scene, int height)
+{
+    AddGround(scene);
+
+    for (int i = 0; i < height; ++i)
+    {
+        AddBox(scene, glm::vec2(0.0f, 0.5f + (float)i), 0.5f, 0.5f, sm2d::sm2d_Dynamic);
+    }
+}
+
+// StepWorld minus the bullets and the islands
+void Step(Stack& scene)
+{
+    sm2d::World& world = scene.world;
+
+    if (world.settings.solverType != sm2d::sm2d_SolverSoftStep)
+    {
+        sm2d::LoadBodies(world, TIME_STEP);
+        sm2d::IntegrateBodies(world);
+        sm2d::StoreBodies(world);
+    }
+
+    sm2d::UpdateColliders(world);
+    sm2d::GetCollisionsInWorld(world);
+    sm2d::SolveContacts(world, TIME_STEP);
+}
+
+template<typename Build>
+void Run(const char* sceneName, const char* solverName, sm2d::SolverType solver, int steps,
+         Build build)
+{
+    Stack scene;
+    scene.world.settings.solverType = solver;
+    build(scene);
+
+    size_t contacts = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < steps; ++i)
+    {
+        Step(scene);
+        contacts += scene.world.contacts.size();
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+
+    // Drift of the dynamic boxes, the last one is the top of the stack
+    float averageDrift = 0.0f;
+    float maxDrift = 0.0f;
+    int   dynamicCount = 0;
+    for (int i = 0; i < (int)scene.bodies.size(); ++i)
+    {
+        if (scene.bodies[i].rigidbody.type != sm2d::sm2d_Dynamic)
+            continue;
+
+        float drift = glm::length(glm::vec2(scene.bodies[i].transform.position) -
+                                  scene.startPositions[i]);
+        averageDrift += drift;
+        maxDrift = std::max(maxDrift, drift);
+        ++dynamicCount;
+    }
+    averageDrift /= (float)std::max(dynamicCount, 1);
+
+    // FNV-1a over the bits of every position and rotation
+    uint64_t hash = 14695981039346656037ull;
+    for (const Body& body : scene.bodies)
+    {
+        float state[3] = {body.transform.position.x, body.transform.position.y,
+                          body.transform.rotation.z};
+        unsigned char bytes[sizeof(state)];
+        std::memcpy(bytes, state, sizeof(state));
+        for (unsigned char byte : bytes)
+        {
+            hash = (hash ^ byte) * 1099511628211ull;
+        }
+    }
+
+    const Body& top = scene.bodies.back();
+    float       topDrop = scene.startPositions.back().y - top.transform.position.y;
+
+    std::printf("%-8s %-8s %4d boxes: %8.3f ms/step, %6zu contacts/step, "
+                "drift avg %.3f max %.3f, top box dropped %.3f, hash %016llx\n",
+                sceneName, solverName, dynamicCount, elapsed.count() / steps,
+                contacts / (size_t)steps, averageDrift, maxDrift, topDrop,
+                (unsigned long long)hash);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // The engine headers pull in Jolt, which needs its allocator even if it's never used
+    JPH::RegisterDefaultAllocator();
+
+    int steps = argc > 1 ? std::atoi(argv[1]) : 600;
+    int pyramidRows = argc > 2 ? std::atoi(argv[2]) : 20;
+    int towerHeight = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    struct
+    {
+        const char*      name;
+        sm2d::SolverType type;
+    } solvers[] = {{"impulse", sm2d::sm2d_SolverImpulse}, {"soft", sm2d::sm2d_SolverSoftStep}};
+
+    for (const auto& solver : solvers)
+    {
+        Run("pyramid", solver.name, solver.type, steps,
+            [&](Stack& scene) { BuildPyramid(scene, pyramidRows); });
+    }
+
+    for (const auto& solver : solvers)
+    {
+        Run("tower", solver.name, solver.type, steps,
+            [&](Stack& scene) { BuildTower(scene, towerHeight); });
+    }
+
+    return 0;
+}
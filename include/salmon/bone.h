@@ -70,19 +70,23 @@ class Bone
         }
     }
 
-    void Update(float animationTime)
+    void Update(float animationTime) { m_LocalTransform = Evaluate(animationTime); }
+
+    // Returns the local transform at the time without storing it, so animators sharing the bone
+    // can evaluate it on different threads
+    glm::mat4 Evaluate(float animationTime) const
     {
         glm::mat4 translation = InterpolatePosition(animationTime);
         glm::mat4 rotation = InterpolateRotation(animationTime);
         glm::mat4 scale = InterpolateScaling(animationTime);
-        m_LocalTransform = translation * rotation * scale;
+        return translation * rotation * scale;
     }
 
     glm::mat4 GetLocalTransform() { return m_LocalTransform; }
     std::string GetBoneName() const { return m_Name; }
     int GetBoneID() { return m_ID; }
 
-    int GetPositionIndex(float animationTime)
+    int GetPositionIndex(float animationTime) const
     {
         for (int index = 0; index < m_NumPositions - 1; ++index)
         {
@@ -93,7 +97,7 @@ class Bone
         assert(0);
     }
 
-    int GetRotationIndex(float animationTime)
+    int GetRotationIndex(float animationTime) const
     {
         for (int index = 0; index < m_NumRotations - 1; ++index)
         {
@@ -104,7 +108,7 @@ class Bone
         assert(0);
     }
 
-    int GetScaleIndex(float animationTime)
+    int GetScaleIndex(float animationTime) const
     {
         for (int index = 0; index < m_NumScalings - 1; ++index)
         {
@@ -116,7 +120,7 @@ class Bone
     }
 
   private:
-    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+    float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const
     {
         float scaleFactor = 0.0f;
         float midWayLength = animationTime - lastTimeStamp;
@@ -125,7 +129,7 @@ class Bone
         return scaleFactor;
     }
 
-    glm::mat4 InterpolatePosition(float animationTime)
+    glm::mat4 InterpolatePosition(float animationTime) const
     {
         if (1 == m_NumPositions)
             return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
@@ -138,7 +142,7 @@ class Bone
         return glm::translate(glm::mat4(1.0f), finalPosition);
     }
 
-    glm::mat4 InterpolateRotation(float animationTime)
+    glm::mat4 InterpolateRotation(float animationTime) const
     {
         if (1 == m_NumRotations)
         {
@@ -156,7 +160,7 @@ class Bone
         return glm::toMat4(finalRotation);
     }
 
-    glm::mat4 InterpolateScaling(float animationTime)
+    glm::mat4 InterpolateScaling(float animationTime) const
     {
         if (1 == m_NumScalings)
             return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
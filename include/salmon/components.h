@@ -2,6 +2,7 @@
 
 #include <salmon/ecs.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <salmon/model.h>
 #include <string>
 #include <salmon/physics.h>
@@ -33,8 +34,9 @@ struct Transform
     glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 rotation = glm::vec3(0.0f);
     glm::vec3 scale = glm::vec3(1.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // Set by the physics with modelMat
     glm::mat4 modelMat = glm::mat4(1.0f);
-    bool useMatrix = false;
+    bool useMatrix = false; // Render with modelMat instead of position, rotation and scale
 };
 
 // Component that describes how a mesh should be renderered at the transform of the entity
@@ -66,6 +68,8 @@ struct RigidBody3D
     float sphereRadius = 1.0f;
     float capsuleRadius = 1.0f;
     float capsuleHeight = 2.0f;
+    float meshWeldDistance = 0.0001f; // Mesh collider vertices about this close are merged
+    float meshDecimation = 0.0f; // Simplifies the mesh collider by merging vertices this close
 
     glm::vec3 offset = glm::vec3(0.0f); // Offset to displace the render position and the physics position
 
@@ -119,27 +123,29 @@ void RigidBody3DStartSys();
 void RigidBody3DSys();
 void AnimatorStartSys();
 
+// Restores a physics snapshot saved with SavePhysicsSnapshot and moves the transforms of the
+// snapshot's bodies to match, returns false if the snapshot couldn't be restored
+bool RestoreSnapshot(uint64_t id);
+
+// Only reads the animation, so animators can be updated on different threads
 inline void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform, Animator* anim)
 {
-    std::string nodeName = node->name;
     glm::mat4 nodeTransform = node->transformation;
 
-    Bone* Bone = anim->currentAnimation->FindBone(nodeName);
+    const Bone* bone = anim->currentAnimation->FindBone(node->name);
 
-    if (Bone)
+    if (bone)
     {
-        Bone->Update(anim->currentTime);
-        nodeTransform = Bone->GetLocalTransform();
+        nodeTransform = bone->Evaluate(anim->currentTime);
     }
 
     glm::mat4 globalTransformation = parentTransform * nodeTransform;
 
-    auto boneInfoMap = anim->currentAnimation->GetBoneIDMap();
-    if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+    const std::map<std::string, BoneInfo>& boneInfoMap = anim->currentAnimation->GetBoneIDMap();
+    auto boneInfo = boneInfoMap.find(node->name);
+    if (boneInfo != boneInfoMap.end())
     {
-        int index = boneInfoMap[nodeName].id;
-        glm::mat4 offset = boneInfoMap[nodeName].offset;
-        anim->boneMatrices[index] = globalTransformation * offset;
+        anim->boneMatrices[boneInfo->second.id] = globalTransformation * boneInfo->second.offset;
     }
 
     for (int i = 0; i < node->childrenCount; i++)
@@ -0,0 +1,81 @@
+#pragma once
+
+// The engine's job system, one pool of worker threads that Jolt, sm2d and the engine systems all
+// run their work on, so they share the cores instead of each starting a thread per core
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+#include <Jolt/Core/FixedSizeFreeList.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline unsigned int cMaxJobs = 4096;     // Most jobs alive at once, a Jolt step can use up to 2048
+inline unsigned int cMaxBarriers = 16;   // Most Jolt barriers that can exist at once
+inline unsigned int cMaxJobWorkers = 31; // Cap on the worker threads on machines with many cores
+
+// Work stealing scheduler, every worker has its own queue that it pushes to and pops from the back
+// of, and a worker whose queue is empty steals from the front of the others'. Threads that aren't
+// workers push into one shared queue. It implements JPH::JobSystem so Jolt can step on it, engine
+// code uses ParallelFor for data parallel loops and Schedule for one-off tasks
+class EngineJobSystem : public JPH::JobSystemWithBarrier
+{
+  public:
+    // A negative thread count starts one worker per core minus one for the main thread
+    EngineJobSystem(int threadCount = -1);
+    ~EngineJobSystem() override;
+
+    // Splits [0, count) into at most GetWorkerCount() contiguous ranges of at least minRange
+    // items, calls task(begin, end, rangeIndex) for each of them and waits until all are done.
+    // Range i always covers the same items for the same count, no matter which thread runs it
+    void ParallelFor(int count, int minRange, const std::function<void(int, int, int)>& task);
+
+    // Returns how many ranges ParallelFor splits count items into
+    int GetRangeCount(int count, int minRange) const;
+
+    // Returns the number of threads that run work, counting the thread that waits on it
+    int GetWorkerCount() const { return (int)threads.size() + 1; }
+
+    // Queues a task to run on a worker, the handle says when it's done
+    JPH::JobHandle Schedule(const char* name, const std::function<void()>& task);
+
+    // Runs other jobs until the task is done, so waiting from inside a job can't deadlock
+    void Wait(const JPH::JobHandle& handle);
+
+    // Runs one queued job on this thread, returns false if there wasn't one
+    bool RunPendingJob();
+
+    // See JPH::JobSystem
+    int            GetMaxConcurrency() const override { return GetWorkerCount(); }
+    JPH::JobHandle CreateJob(const char* name, JPH::ColorArg color, const JobFunction& function,
+                             JPH::uint32 dependencyCount = 0) override;
+
+  protected:
+    void QueueJob(Job* job) override;
+    void QueueJobs(Job** jobs, JPH::uint jobCount) override;
+    void FreeJob(Job* job) override;
+
+  private:
+    struct JobQueue
+    {
+        std::mutex       mutex;
+        std::deque<Job*> jobs;
+    };
+
+    void WorkerLoop(int queueIndex);
+    int  GetQueueIndex() const;
+    Job* TakeJob(int queueIndex);
+
+    JPH::FixedSizeFreeList<Job>            jobPool;
+    std::vector<std::unique_ptr<JobQueue>> queues; // queues[0] is for threads that aren't workers
+    std::vector<std::thread>               threads;
+    std::atomic<int>                       queuedJobs = 0; // Workers sleep while this is zero
+    std::atomic<bool>                      quitting = false;
+};
+
+// Returns the job system shared by the whole engine, it gets created the first time it's used
+EngineJobSystem& GetJobSystem();
@@ -40,6 +40,7 @@ class Model
                                           // aren't loaded more than once.
     std::vector<Mesh> meshes;
     std::string directory;
+    std::string path; // File the model was loaded from, empty if it wasn't loaded from one
     std::vector<float> colliderVertices;
     std::vector<uint32_t> colliderIndices;
     bool gammaCorrection;
@@ -47,7 +48,7 @@ class Model
 
     // constructor, expects a filepath to a 3D model.
     Model(std::string const& path, bool gamma = false, bool extractTexture = true)
-       : gammaCorrection(gamma), extractTexture(extractTexture)
+       : path(path), gammaCorrection(gamma), extractTexture(extractTexture)
     {
         loadModel(path);
         extractCollisionMesh();
@@ -68,6 +69,9 @@ class Model
     {
         for (const Mesh& mesh : meshes)
         {
+            // Each mesh's indices start at zero, so they're offset by the vertices already added
+            uint32_t firstVertex = (uint32_t)(colliderVertices.size() / 3);
+
             // Add the vertex positions to the colliderVertices
             for (const Vertex& vertex : mesh.vertices)
             {
@@ -77,7 +81,10 @@ class Model
             }
 
             // Add the indices to the colliderIndices
-            colliderIndices.insert(colliderIndices.end(), mesh.indices.begin(), mesh.indices.end());
+            for (unsigned int index : mesh.indices)
+            {
+                colliderIndices.push_back(firstVertex + index);
+            }
         }
     }
 
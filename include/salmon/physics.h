@@ -10,7 +10,8 @@
 #include <Jolt/RegisterTypes.h>
 #include <Jolt/Core/Factory.h>
 #include <Jolt/Core/TempAllocator.h>
-#include <Jolt/Core/JobSystemThreadPool.h>
+#include <Jolt/Core/HashCombine.h>
+#include <Jolt/Core/StreamWrapper.h>
 #include <Jolt/Physics/PhysicsSettings.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
@@ -20,12 +21,30 @@
 #include <Jolt/Physics/Body/BodyActivationListener.h>
 #include <Jolt/Physics/Collision/Shape/TriangleShape.h>
 #include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <Jolt/Physics/Collision/Shape/ScaledShape.h>
 #include <Jolt/Physics/Collision/ContactListener.h>
 #include <Jolt/Physics/Collision/RayCast.h>
 #include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/ShapeCast.h>
+#include <Jolt/Physics/Collision/CollideShape.h>
+#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
+#include <Jolt/Physics/StateRecorder.h>
 #include <salmon/renderer.h>
 #include <salmon/engine.h>
+#include <salmon/job_system.h>
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
 
 #ifdef JPH_DEBUG_RENDERER
 #    include <Jolt/Renderer/DebugRenderer.h>
@@ -181,19 +200,484 @@ inline unsigned int cNumBodyMutexes = 0; // Autodetect
 inline unsigned int cMaxBodyPairs = 65536;
 inline unsigned int cMaxContactConstraints = 20480;
 
-inline JPH::PhysicsSystem        physicsSystem;
-inline JPH::TempAllocatorImpl*   tempAllocator;
-inline JPH::JobSystemThreadPool* jobSystem;
+// Temp allocator for the physics step that keeps track of how much of its block gets used. When the
+// block is full it falls back to the heap and counts it, instead of aborting like TempAllocatorImpl
+class TrackingTempAllocator final : public JPH::TempAllocator
+{
+  public:
+    JPH_OVERRIDE_NEW_DELETE
+
+    explicit TrackingTempAllocator(JPH::uint size) : allocator(size) {}
+
+    virtual void* Allocate(JPH::uint size) override
+    {
+        if (!allocator.CanAllocate(size))
+        {
+            ++fallbackCount;
+            return fallback.Allocate(size);
+        }
+
+        void* address = allocator.Allocate(size);
+        peakUsage = std::max(peakUsage, allocator.GetUsage());
+        return address;
+    }
+
+    virtual void Free(void* address, JPH::uint size) override
+    {
+        if (address == nullptr)
+            return;
+
+        if (allocator.OwnsMemory(address))
+            allocator.Free(address, size);
+        else
+            fallback.Free(address, size);
+    }
+
+    JPH::uint GetSize() const { return allocator.GetSize(); }
+
+    // Most bytes of the block in use at once and allocations that didn't fit, since the last reset
+    JPH::uint GetPeakUsage() const { return peakUsage; }
+    JPH::uint GetFallbackCount() const { return fallbackCount; }
+
+    void ResetPeak()
+    {
+        peakUsage = allocator.GetUsage();
+        fallbackCount = 0;
+    }
+
+  private:
+    JPH::TempAllocatorImpl   allocator;
+    JPH::TempAllocatorMalloc fallback;
+    JPH::uint                peakUsage = 0;
+    JPH::uint                fallbackCount = 0;
+};
+
+inline JPH::PhysicsSystem     physicsSystem;
+inline TrackingTempAllocator* tempAllocator;
+inline JPH::JobSystem*        jobSystem; // The engine job system, Jolt doesn't own its threads
+
+// Warn when a capacity is at least this full
+inline float cCapacityWarningFraction = 0.9f;
+
+// What the last physics step did and how close it came to the limits the physics system was
+// created with. Jolt's own phases can only be timed with its profiler, so the times are of the
+// engine's phases around the step
+struct PhysicsStats
+{
+    uint64_t steps = 0;
+
+    uint32_t bodies = 0;
+    uint32_t activeBodies = 0;
+    uint32_t bodyPairs = 0;          // Pairs of bodies that touched during the step
+    uint32_t contactConstraints = 0; // One per touching pair of sub shapes
+
+    uint32_t  tempPeak = 0;       // Most temp allocator bytes in use during the step
+    uint32_t  tempPeakEver = 0;   // The same over every step so far
+    uint32_t  tempFallbacks = 0;  // Allocations that didn't fit and went to the heap
+    JPH::uint overflowErrors = 0; // EPhysicsUpdateError bits that Jolt returned from the step
+
+    double stepMs = 0.0;      // Jolt's PhysicsSystem::Update
+    double contactsMs = 0.0;  // Delivering the contact events
+    double syncMs = 0.0;      // Copying the active bodies into their transforms
+    double addBodiesMs = 0.0; // Adding the bodies created since the last step
+};
 
+inline PhysicsStats physicsStats;
+
+// Bits of the warnings that have been printed, so each one prints once until its cause goes away
+inline uint32_t physicsWarnings = 0;
+
+// Returns true the first time the condition holds, and again once it has stopped holding for a step
+inline bool ShouldWarn(uint32_t bit, bool condition)
+{
+    bool warn = condition && (physicsWarnings & bit) == 0;
+    physicsWarnings = condition ? physicsWarnings | bit : physicsWarnings & ~bit;
+    return warn;
+}
+
+inline void WarnNearCapacity(uint32_t bit, const char* name, uint64_t used, uint64_t capacity)
+{
+    if (ShouldWarn(bit, used >= capacity * cCapacityWarningFraction))
+    {
+        std::cerr << "WARNING: Physics " << name << " at " << used << " of " << capacity
+                  << ", raise the limit before it overflows" << std::endl;
+    }
+}
+
+// Warns about the capacities the last step came close to, and about the ones it overflowed, which
+// Jolt handles by dropping contacts
+inline void CheckPhysicsCapacity()
+{
+    const PhysicsStats& stats = physicsStats;
+
+    WarnNearCapacity(1 << 0, "bodies", stats.bodies, physicsSystem.GetMaxBodies());
+    WarnNearCapacity(1 << 1, "contact constraints", stats.contactConstraints,
+                     cMaxContactConstraints);
+    WarnNearCapacity(1 << 2, "body pairs", stats.bodyPairs, cMaxBodyPairs);
+    WarnNearCapacity(1 << 3, "temp allocator bytes", stats.tempPeak, tempAllocator->GetSize());
+
+    if (ShouldWarn(1 << 4, stats.tempFallbacks > 0))
+        std::cerr << "WARNING: Physics temp allocator is full, allocations are going to the heap"
+                  << std::endl;
+
+    JPH::uint errors = stats.overflowErrors;
+    if (ShouldWarn(1 << 5, errors & (JPH::uint)JPH::EPhysicsUpdateError::ManifoldCacheFull))
+        std::cerr << "ERROR: Physics manifold cache is full, raise cMaxContactConstraints"
+                  << std::endl;
+    if (ShouldWarn(1 << 6, errors & (JPH::uint)JPH::EPhysicsUpdateError::BodyPairCacheFull))
+        std::cerr << "ERROR: Physics body pair cache is full, raise cMaxBodyPairs" << std::endl;
+    if (ShouldWarn(1 << 7, errors & (JPH::uint)JPH::EPhysicsUpdateError::ContactConstraintsFull))
+        std::cerr << "ERROR: Physics contact constraints are full, raise cMaxContactConstraints"
+                  << std::endl;
+}
+
+inline void DispatchContactEvents();
+
+// Milliseconds since start, for the stats
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// Steps the physics and then calls the collision callbacks of the contacts it found
 inline void StepPhysics(float deltaTime)
 {
-    physicsSystem.Update(deltaTime, 1, tempAllocator, jobSystem);
+    tempAllocator->ResetPeak();
+
+    auto                     start = std::chrono::steady_clock::now();
+    JPH::EPhysicsUpdateError errors = physicsSystem.Update(deltaTime, 1, tempAllocator, jobSystem);
+    physicsStats.stepMs = MillisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    DispatchContactEvents();
+    physicsStats.contactsMs = MillisecondsSince(start);
+
+    PhysicsStats& stats = physicsStats;
+    stats.steps++;
+    stats.bodies = physicsSystem.GetNumBodies();
+    stats.activeBodies = physicsSystem.GetNumActiveBodies(JPH::EBodyType::RigidBody);
+    stats.tempPeak = tempAllocator->GetPeakUsage();
+    stats.tempPeakEver = std::max(stats.tempPeakEver, stats.tempPeak);
+    stats.tempFallbacks = tempAllocator->GetFallbackCount();
+    stats.overflowErrors = (JPH::uint)errors;
+
+    CheckPhysicsCapacity();
+}
+
+// Dimensions that round to the same multiple of this share a shape in the shape cache
+inline float cShapeCacheQuantum = 0.001f;
+
+// Identifies a shape in the shape cache by its type and quantized dimensions
+struct ShapeKey
+{
+    JPH::EShapeSubType type;
+    int32_t            dimensions[3];
+
+    bool operator==(const ShapeKey& other) const
+    {
+        return type == other.type && dimensions[0] == other.dimensions[0] &&
+               dimensions[1] == other.dimensions[1] && dimensions[2] == other.dimensions[2];
+    }
+};
+
+struct ShapeKeyHash
+{
+    size_t operator()(const ShapeKey& key) const
+    {
+        size_t hash = 0;
+        JPH::HashCombine(hash, (int)key.type, key.dimensions[0], key.dimensions[1],
+                         key.dimensions[2]);
+        return hash;
+    }
+};
+
+// Shapes can't change once they're created, so every body with the same collider type and size
+// shares one instead of each building its own. Shapes stay in the cache until DestroyPhysics
+inline std::unordered_map<ShapeKey, JPH::ShapeRefC, ShapeKeyHash> shapeCache;
+
+// Returns the cached shape of the type and dimensions, calling createShape with the quantized
+// dimensions on a miss so a shape is the same whichever body asked for it first. Returns nullptr
+// if the shape can't be created
+template <typename CreateShape>
+inline JPH::ShapeRefC GetCachedShape(JPH::EShapeSubType type, JPH::Vec3 dimensions,
+                                     CreateShape createShape)
+{
+    ShapeKey key;
+    key.type = type;
+    for (int i = 0; i < 3; ++i)
+    {
+        key.dimensions[i] = (int32_t)std::lround(dimensions[i] / cShapeCacheQuantum);
+    }
+
+    auto it = shapeCache.find(key);
+    if (it != shapeCache.end())
+        return it->second;
+
+    JPH::Vec3 quantized((float)key.dimensions[0] * cShapeCacheQuantum,
+                        (float)key.dimensions[1] * cShapeCacheQuantum,
+                        (float)key.dimensions[2] * cShapeCacheQuantum);
+
+    JPH::ShapeSettings::ShapeResult result = createShape(quantized);
+    if (result.HasError())
+    {
+        std::cerr << "ERROR: Failed to create shape: " << result.GetError() << std::endl;
+        return nullptr;
+    }
+
+    shapeCache.emplace(key, result.Get());
+    return result.Get();
+}
+
+inline JPH::ShapeRefC GetBoxShape(JPH::Vec3 halfExtent)
+{
+    return GetCachedShape(JPH::EShapeSubType::Box, halfExtent,
+                          [](JPH::Vec3 dimensions)
+                          {
+                              JPH::BoxShapeSettings settings(dimensions);
+                              settings.SetEmbedded();
+                              return settings.Create();
+                          });
+}
+
+inline JPH::ShapeRefC GetSphereShape(float radius)
+{
+    return GetCachedShape(JPH::EShapeSubType::Sphere, JPH::Vec3(radius, 0.0f, 0.0f),
+                          [](JPH::Vec3 dimensions)
+                          {
+                              JPH::SphereShapeSettings settings(dimensions.GetX());
+                              settings.SetEmbedded();
+                              return settings.Create();
+                          });
+}
+
+// A capsule is defined by its half height, the distance from its center to a hemisphere's center
+inline JPH::ShapeRefC GetCapsuleShape(float halfHeight, float radius)
+{
+    return GetCachedShape(JPH::EShapeSubType::Capsule, JPH::Vec3(halfHeight, radius, 0.0f),
+                          [](JPH::Vec3 dimensions)
+                          {
+                              JPH::CapsuleShapeSettings settings(dimensions.GetX(),
+                                                                 dimensions.GetY());
+                              settings.SetEmbedded();
+                              return settings.Create();
+                          });
+}
+
+// Folder that cooked mesh shapes are saved in, so later runs load them instead of building them
+inline std::string meshCacheDirectory = "cache/meshes";
+
+// Part of every cooked mesh's file name, bump it when the cooked data or the way meshes are
+// simplified changes so the old files are ignored
+inline uint32_t cMeshCacheVersion = 1;
+
+// Mesh shapes that are already loaded, keyed the same way as their files
+inline std::unordered_map<size_t, JPH::ShapeRefC> meshShapeCache;
+
+// Content hashes of the model files that meshes have been loaded from, so a file is only read once
+inline std::unordered_map<std::string, uint64_t> modelFileHashes;
+
+struct MeshCell
+{
+    int32_t x, y, z;
+
+    bool operator==(const MeshCell& other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+struct MeshCellHash
+{
+    size_t operator()(const MeshCell& cell) const
+    {
+        size_t hash = 0;
+        JPH::HashCombine(hash, cell.x, cell.y, cell.z);
+        return hash;
+    }
+};
+
+// Merges the vertices of a mesh that fall in the same cell of a grid with cells of cellSize into
+// their average. A tiny cell welds the duplicate vertices along the seams between a model's meshes
+// and a bigger one decimates the mesh by collapsing whole regions of it into single vertices. The
+// triangles that collapse are removed when the MeshShapeSettings sanitize the mesh
+inline void ClusterMeshVertices(JPH::VertexList& vertices, JPH::IndexedTriangleList& triangles,
+                                float cellSize)
+{
+    if (cellSize <= 0.0f)
+        return;
+
+    std::unordered_map<MeshCell, uint32_t, MeshCellHash> cells;
+    std::vector<uint32_t>                                remap(vertices.size());
+    std::vector<uint32_t>                                clusterCounts;
+    JPH::VertexList                                      clusters;
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const JPH::Float3& vertex = vertices[i];
+        MeshCell           cell = {(int32_t)std::floor(vertex.x / cellSize),
+                                   (int32_t)std::floor(vertex.y / cellSize),
+                                   (int32_t)std::floor(vertex.z / cellSize)};
+
+        auto [it, inserted] = cells.try_emplace(cell, (uint32_t)clusters.size());
+        if (inserted)
+        {
+            clusters.push_back(JPH::Float3(0.0f, 0.0f, 0.0f));
+            clusterCounts.push_back(0);
+        }
+
+        JPH::Float3& sum = clusters[it->second];
+        sum.x += vertex.x;
+        sum.y += vertex.y;
+        sum.z += vertex.z;
+        clusterCounts[it->second]++;
+        remap[i] = it->second;
+    }
+
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        float scale = 1.0f / (float)clusterCounts[i];
+        clusters[i] = JPH::Float3(clusters[i].x * scale, clusters[i].y * scale,
+                                  clusters[i].z * scale);
+    }
+
+    for (JPH::IndexedTriangle& triangle : triangles)
+    {
+        for (JPH::uint32& index : triangle.mIdx)
+        {
+            index = remap[index];
+        }
+    }
+
+    vertices = std::move(clusters);
+}
+
+// Hashes the contents of a model file, falls back to hashing the collision mesh itself if the model
+// didn't come from a file or the file can't be read
+inline uint64_t HashModel(const std::string& modelPath, const std::vector<float>& vertices,
+                          const std::vector<uint32_t>& indices)
+{
+    if (!modelPath.empty())
+    {
+        auto it = modelFileHashes.find(modelPath);
+        if (it != modelFileHashes.end())
+            return it->second;
+
+        std::ifstream file(modelPath, std::ios::binary);
+        if (file)
+        {
+            std::string contents((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+            uint64_t    hash = JPH::HashBytes(contents.data(), (JPH::uint)contents.size());
+            modelFileHashes.emplace(modelPath, hash);
+            return hash;
+        }
+    }
+
+    uint64_t hash = JPH::HashBytes(vertices.data(), (JPH::uint)(vertices.size() * sizeof(float)));
+    return JPH::HashBytes(indices.data(), (JPH::uint)(indices.size() * sizeof(uint32_t)), hash);
+}
+
+// Returns the mesh shape of a model's collision mesh, which is three floats per vertex and three
+// indices per triangle, with its vertices clustered by cellSize. Building the tree of a mesh shape
+// is slow so the cooked shape is saved into meshCacheDirectory under a hash of the model file, and
+// later runs load it from there. Returns nullptr if the mesh has no triangles
+inline JPH::ShapeRefC GetMeshShape(const std::string& modelPath, const std::vector<float>& vertices,
+                                   const std::vector<uint32_t>& indices, float cellSize)
+{
+    if (indices.size() < 3)
+        return nullptr;
+
+    size_t key = HashModel(modelPath, vertices, indices);
+    JPH::HashCombine(key, cellSize, cMeshCacheVersion);
+
+    auto cached = meshShapeCache.find(key);
+    if (cached != meshShapeCache.end())
+        return cached->second;
+
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.jmesh", (unsigned long long)key);
+    std::filesystem::path filePath = std::filesystem::path(meshCacheDirectory) / fileName;
+
+    // Load the cooked shape if an earlier run saved it
+    std::ifstream inFile(filePath, std::ios::binary);
+    if (inFile)
+    {
+        JPH::StreamInWrapper    stream(inFile);
+        JPH::Shape::ShapeResult result = JPH::Shape::sRestoreFromBinaryState(stream);
+        if (result.IsValid() && !stream.IsFailed())
+        {
+            meshShapeCache.emplace(key, result.Get());
+            return result.Get();
+        }
+
+        std::cerr << "WARNING: Cooked mesh " << filePath << " is invalid, rebuilding it"
+                  << std::endl;
+    }
+
+    JPH::VertexList vertexList;
+    vertexList.reserve(vertices.size() / 3);
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+    {
+        vertexList.push_back(JPH::Float3(vertices[i], vertices[i + 1], vertices[i + 2]));
+    }
+
+    JPH::IndexedTriangleList triangles;
+    triangles.reserve(indices.size() / 3);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        triangles.push_back(JPH::IndexedTriangle(indices[i], indices[i + 1], indices[i + 2]));
+    }
+
+    ClusterMeshVertices(vertexList, triangles, cellSize);
+
+    // The constructor sanitizes the mesh, removing the triangles that clustering collapsed
+    JPH::MeshShapeSettings settings(std::move(vertexList), std::move(triangles));
+    settings.SetEmbedded();
+
+    JPH::ShapeSettings::ShapeResult result = settings.Create();
+    if (result.HasError())
+    {
+        std::cerr << "ERROR: Failed to create mesh shape: " << result.GetError() << std::endl;
+        return nullptr;
+    }
+
+    // Write to a temporary file first so a run that stops halfway never leaves a broken file behind
+    std::error_code error;
+    std::filesystem::create_directories(meshCacheDirectory, error);
+
+    std::filesystem::path tempPath = filePath;
+    tempPath += ".tmp";
+
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (outFile)
+    {
+        JPH::StreamOutWrapper stream(outFile);
+        result.Get()->SaveBinaryState(stream);
+        outFile.close();
+
+        if (!stream.IsFailed() && outFile)
+        {
+            std::filesystem::rename(tempPath, filePath, error);
+        }
+        else
+        {
+            std::filesystem::remove(tempPath, error);
+        }
+    }
+
+    meshShapeCache.emplace(key, result.Get());
+    return result.Get();
 }
 
 inline void DestroyPhysics()
 {
+    // Drops the cache's references, shapes that bodies still use live until the bodies are gone
+    shapeCache.clear();
+    meshShapeCache.clear();
+
     delete tempAllocator;
-    delete jobSystem;
+    jobSystem = nullptr;
 
     JPH::UnregisterTypes();
 
@@ -210,6 +694,147 @@ struct LineSeg
 
 inline JPH::BodyInterface& bodyInterface = physicsSystem.GetBodyInterface();
 
+// Bodies that have been created but aren't in the physics system yet. Adding bodies one at a time
+// inserts each one into the broadphase tree and fragments it, so they're queued and added together
+inline std::vector<JPH::BodyID> pendingBodies;
+
+// Queues a body created with bodyInterface.CreateBody to be added with the next batch
+inline void QueueBodyAdd(const JPH::Body* body)
+{
+    pendingBodies.push_back(body->GetID());
+}
+
+// Adds every queued body to the physics system in one batch and activates the dynamic ones.
+// Rebuilding the broadphase afterwards is worth it after a bulk load like a level, batches added
+// into empty space while the game runs don't need it
+inline void AddPendingBodies(bool optimizeBroadPhase)
+{
+    if (pendingBodies.empty())
+    {
+        physicsStats.addBodiesMs = 0.0;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int  count = (int)pendingBodies.size();
+
+    // Prepare sorts the ids by broadphase layer, they have to stay like that until Finalize
+    JPH::BodyInterface::AddState state = bodyInterface.AddBodiesPrepare(pendingBodies.data(), count);
+    bodyInterface.AddBodiesFinalize(pendingBodies.data(), count, state, JPH::EActivation::Activate);
+    pendingBodies.clear();
+
+    if (optimizeBroadPhase)
+    {
+        physicsSystem.OptimizeBroadPhase();
+    }
+
+    physicsStats.addBodiesMs = MillisecondsSince(start);
+}
+
+inline const char* cObjectLayerNames[Layers::NUM_LAYERS] = {"NON_MOVING", "MOVING"};
+inline const char* cBroadPhaseLayerNames[BroadPhaseLayers::NUM_LAYERS] = {"NON_MOVING", "MOVING"};
+
+// How the bodies are spread over the layers. Each broadphase layer is a tree of its own, so a
+// layer that holds most of the bodies is the one to split
+struct PhysicsLayerStats
+{
+    uint32_t objectLayerBodies[Layers::NUM_LAYERS] = {};
+    uint32_t objectLayerActiveBodies[Layers::NUM_LAYERS] = {};
+    uint32_t broadPhaseLayerBodies[BroadPhaseLayers::NUM_LAYERS] = {};
+};
+
+// Counts the bodies in every layer. It goes through every body, so call it when the numbers are
+// wanted rather than every step, and only between steps
+inline PhysicsLayerStats GetPhysicsLayerStats()
+{
+    PhysicsLayerStats    stats;
+    BPLayerInterfaceImpl broadPhaseLayers;
+
+    JPH::BodyIDVector ids;
+    physicsSystem.GetBodies(ids);
+
+    const JPH::BodyLockInterfaceNoLock& bodies = physicsSystem.GetBodyLockInterfaceNoLock();
+    for (JPH::BodyID id : ids)
+    {
+        const JPH::Body* body = bodies.TryGetBody(id);
+        if (body == nullptr)
+            continue;
+
+        JPH::ObjectLayer layer = body->GetObjectLayer();
+        stats.objectLayerBodies[layer]++;
+        stats.objectLayerActiveBodies[layer] += body->IsActive();
+        stats.broadPhaseLayerBodies[(JPH::BroadPhaseLayer::Type)broadPhaseLayers.GetBroadPhaseLayer(
+            layer)]++;
+    }
+
+    return stats;
+}
+
+// Returns the last step's stats, the capacities and the layer stats as JSON, for tools and build
+// scripts to read
+inline std::string PhysicsStatsToJson()
+{
+    const PhysicsStats& stats = physicsStats;
+    PhysicsLayerStats   layers = GetPhysicsLayerStats();
+
+    std::string json = "{\n";
+    json += "  \"steps\": " + std::to_string(stats.steps) + ",\n";
+    json += "  \"bodies\": " + std::to_string(stats.bodies) + ",\n";
+    json += "  \"maxBodies\": " + std::to_string(physicsSystem.GetMaxBodies()) + ",\n";
+    json += "  \"activeBodies\": " + std::to_string(stats.activeBodies) + ",\n";
+    json += "  \"bodyPairs\": " + std::to_string(stats.bodyPairs) + ",\n";
+    json += "  \"maxBodyPairs\": " + std::to_string(cMaxBodyPairs) + ",\n";
+    json += "  \"contactConstraints\": " + std::to_string(stats.contactConstraints) + ",\n";
+    json += "  \"maxContactConstraints\": " + std::to_string(cMaxContactConstraints) + ",\n";
+    json += "  \"tempAllocatorPeak\": " + std::to_string(stats.tempPeak) + ",\n";
+    json += "  \"tempAllocatorPeakEver\": " + std::to_string(stats.tempPeakEver) + ",\n";
+    json += "  \"tempAllocatorSize\": " + std::to_string(tempAllocator->GetSize()) + ",\n";
+    json += "  \"tempAllocatorFallbacks\": " + std::to_string(stats.tempFallbacks) + ",\n";
+    json += "  \"overflowErrors\": " + std::to_string(stats.overflowErrors) + ",\n";
+    json += "  \"stepMs\": " + std::to_string(stats.stepMs) + ",\n";
+    json += "  \"contactsMs\": " + std::to_string(stats.contactsMs) + ",\n";
+    json += "  \"syncMs\": " + std::to_string(stats.syncMs) + ",\n";
+    json += "  \"addBodiesMs\": " + std::to_string(stats.addBodiesMs) + ",\n";
+
+    json += "  \"objectLayers\": [\n";
+    for (JPH::ObjectLayer layer = 0; layer < Layers::NUM_LAYERS; ++layer)
+    {
+        json += std::string("    {\"name\": \"") + cObjectLayerNames[layer] + "\", \"bodies\": " +
+                std::to_string(layers.objectLayerBodies[layer]) + ", \"activeBodies\": " +
+                std::to_string(layers.objectLayerActiveBodies[layer]) + "}";
+        json += layer + 1 < Layers::NUM_LAYERS ? ",\n" : "\n";
+    }
+    json += "  ],\n";
+
+    json += "  \"broadPhaseLayers\": [\n";
+    for (JPH::uint layer = 0; layer < BroadPhaseLayers::NUM_LAYERS; ++layer)
+    {
+        json += std::string("    {\"name\": \"") + cBroadPhaseLayerNames[layer] +
+                "\", \"bodies\": " + std::to_string(layers.broadPhaseLayerBodies[layer]) + "}";
+        json += layer + 1 < BroadPhaseLayers::NUM_LAYERS ? ",\n" : "\n";
+    }
+    json += "  ]\n}\n";
+
+    return json;
+}
+
+// Writes PhysicsStatsToJson to a file, returns false if it couldn't be written
+inline bool DumpPhysicsStats(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "ERROR: Couldn't write physics stats to " << path << std::endl;
+        return false;
+    }
+
+    file << PhysicsStatsToJson();
+    return (bool)file;
+}
+
+// Draws the physics stats in an ImGui window, call it between ImGuiLayer::NewFrame and EndFrame
+void PhysicsStatsWindow(bool* open = nullptr);
+
 class MyDebugRenderer final : public JPH::DebugRenderer
 {
   public:
@@ -260,23 +885,251 @@ class MyDebugRenderer final : public JPH::DebugRenderer
     std::vector<glm::vec3> points;
 };
 
+// What happened between two bodies that are in a contact event
+enum class ContactEventType
+{
+    Added,     // The bodies started touching
+    Persisted, // The bodies are still touching, sent every step that they are
+    Removed    // The bodies stopped touching, which also happens when one of them falls asleep
+};
+
+// A contact between two bodies recorded during a physics step, body1's ID is always lower
+struct ContactEvent
+{
+    ContactEventType type;
+    JPH::BodyID      body1;
+    JPH::BodyID      body2;
+};
+
 struct CollisionEventData
 {
-    const JPH::Body*                                                id;
+    ContactEventType                                                type;
     std::function<void(const JPH::Body* id1, const JPH::Body* id2)> call;
-    bool                                                            collide;
 };
 
-inline std::vector<CollisionEventData> registeredCollisions;
+// Callbacks of the bodies that listen for contacts. Jolt's threads look bodies up in it while the
+// physics steps, so it must only be changed between steps
+inline std::unordered_map<JPH::BodyID, std::vector<CollisionEventData>> registeredCollisions;
 
+// Contact events that one thread recorded during a step. Every thread gets its own buffer the first
+// time it records an event, so recording never has to lock
+struct ContactEventBuffer
+{
+    std::vector<ContactEvent> events;
+
+    // Counts of every contact for the stats, not just of the bodies with callbacks
+    uint32_t contactConstraints = 0;
+    uint32_t bodyPairs = 0;
+    uint64_t lastPair = ~0ull;
+};
+
+inline std::mutex                                       contactBuffersMutex;
+inline std::vector<std::unique_ptr<ContactEventBuffer>> contactBuffers;
+
+// How many sub shape pairs of each pair of bodies are touching, so compound and mesh shapes only
+// send one added and one removed event per pair of bodies. Keyed by the two IDs packed together
+inline std::unordered_map<uint64_t, int> touchingSubShapes;
+
+inline void AddCollisionEvent(JPH::Body* id, ContactEventType type,
+                              std::function<void(const JPH::Body* id1, const JPH::Body* id2)> call)
+{
+    registeredCollisions[id->GetID()].push_back(CollisionEventData(type, call));
+}
+
+// Calls back when the body starts touching another body
 inline void
 AddCollisionEnterEvent(JPH::Body*                                                      id,
                        std::function<void(const JPH::Body* id1, const JPH::Body* id2)> call)
 {
-    CollisionEventData data(id, call, true);
-    registeredCollisions.push_back(data);
+    AddCollisionEvent(id, ContactEventType::Added, call);
+}
+
+// Calls back every step that the body is touching another body
+inline void
+AddCollisionStayEvent(JPH::Body*                                                      id,
+                      std::function<void(const JPH::Body* id1, const JPH::Body* id2)> call)
+{
+    AddCollisionEvent(id, ContactEventType::Persisted, call);
+}
+
+// Calls back when the body stops touching another body. The other body is nullptr if it has been
+// removed from the physics system
+inline void
+AddCollisionExitEvent(JPH::Body*                                                      id,
+                      std::function<void(const JPH::Body* id1, const JPH::Body* id2)> call)
+{
+    AddCollisionEvent(id, ContactEventType::Removed, call);
 }
 
+// Removes every callback of the body, call it before destroying a body that has any
+inline void RemoveCollisionEvents(const JPH::Body* id)
+{
+    registeredCollisions.erase(id->GetID());
+
+    // Contacts between it and bodies without callbacks won't be recorded anymore, so they'd never
+    // be uncounted
+    uint32_t index = id->GetID().GetIndexAndSequenceNumber();
+    std::erase_if(touchingSubShapes,
+                  [index](const auto& pair)
+                  {
+                      uint32_t index1 = (uint32_t)(pair.first >> 32);
+                      uint32_t index2 = (uint32_t)pair.first;
+                      if (index1 != index && index2 != index)
+                          return false;
+
+                      JPH::BodyID other(index1 == index ? index2 : index1);
+                      return !registeredCollisions.contains(other);
+                  });
+}
+
+inline ContactEventBuffer& GetThreadContactEventBuffer()
+{
+    thread_local ContactEventBuffer* buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        std::lock_guard lock(contactBuffersMutex);
+        buffer = contactBuffers.emplace_back(std::make_unique<ContactEventBuffer>()).get();
+    }
+
+    return *buffer;
+}
+
+// Counts a touching pair of sub shapes for the stats. A thread goes through all the sub shapes of a
+// pair of bodies before moving on to the next pair, so a new pair starts when the bodies change
+inline void CountContact(JPH::BodyID body1, JPH::BodyID body2)
+{
+    ContactEventBuffer& buffer = GetThreadContactEventBuffer();
+    uint64_t            pair = ((uint64_t)body1.GetIndexAndSequenceNumber() << 32) |
+                    body2.GetIndexAndSequenceNumber();
+
+    buffer.contactConstraints++;
+    if (pair != buffer.lastPair)
+    {
+        buffer.bodyPairs++;
+        buffer.lastPair = pair;
+    }
+}
+
+// Records the event if either body is listening for contacts, called from Jolt's threads
+inline void RecordContactEvent(ContactEventType type, JPH::BodyID body1, JPH::BodyID body2)
+{
+    if (!registeredCollisions.contains(body1) && !registeredCollisions.contains(body2))
+        return;
+
+    GetThreadContactEventBuffer().events.push_back(ContactEvent(type, body1, body2));
+}
+
+// Calls the callbacks of both bodies in the event that are listening for its type
+inline void CallCollisionEvents(const ContactEvent& event)
+{
+    const JPH::BodyLockInterfaceNoLock& bodies = physicsSystem.GetBodyLockInterfaceNoLock();
+    const JPH::Body*                    body1 = bodies.TryGetBody(event.body1);
+    const JPH::Body*                    body2 = bodies.TryGetBody(event.body2);
+
+    // Callbacks can add and remove callbacks, so the ones to call are copied out first
+    std::vector<std::function<void(const JPH::Body* id1, const JPH::Body* id2)>> calls;
+    for (JPH::BodyID id : {event.body1, event.body2})
+    {
+        auto it = registeredCollisions.find(id);
+        if (it == registeredCollisions.end())
+            continue;
+
+        for (const CollisionEventData& data : it->second)
+        {
+            if (data.type == event.type)
+            {
+                calls.push_back(data.call);
+            }
+        }
+    }
+
+    for (const auto& call : calls)
+    {
+        call(body1, body2);
+    }
+}
+
+// Delivers the contact events that the last step recorded on the main thread, where the callbacks
+// are free to touch the scene. Events of sub shapes are merged into events of their bodies, and
+// added events go first so a body that slid from one part of a mesh to another stays touching it
+inline void DispatchContactEvents()
+{
+    std::vector<ContactEvent> persisted;
+    std::vector<ContactEvent> removed;
+
+    physicsStats.contactConstraints = 0;
+    physicsStats.bodyPairs = 0;
+
+    for (const std::unique_ptr<ContactEventBuffer>& buffer : contactBuffers)
+    {
+        physicsStats.contactConstraints += buffer->contactConstraints;
+        physicsStats.bodyPairs += buffer->bodyPairs;
+        buffer->contactConstraints = 0;
+        buffer->bodyPairs = 0;
+        buffer->lastPair = ~0ull;
+
+        for (const ContactEvent& event : buffer->events)
+        {
+            uint64_t pair = ((uint64_t)event.body1.GetIndexAndSequenceNumber() << 32) |
+                            event.body2.GetIndexAndSequenceNumber();
+
+            if (event.type == ContactEventType::Added)
+            {
+                if (touchingSubShapes[pair]++ == 0)
+                {
+                    CallCollisionEvents(event);
+                }
+            }
+            else if (event.type == ContactEventType::Persisted)
+            {
+                persisted.push_back(event);
+            }
+            else
+            {
+                removed.push_back(event);
+            }
+        }
+
+        buffer->events.clear();
+    }
+
+    // Every touching sub shape sends its own persisted event, the body pair only gets one
+    std::sort(persisted.begin(), persisted.end(),
+              [](const ContactEvent& a, const ContactEvent& b)
+              {
+                  if (a.body1 != b.body1)
+                      return a.body1 < b.body1;
+                  return a.body2 < b.body2;
+              });
+
+    for (size_t i = 0; i < persisted.size(); ++i)
+    {
+        if (i > 0 && persisted[i].body1 == persisted[i - 1].body1 &&
+            persisted[i].body2 == persisted[i - 1].body2)
+            continue;
+
+        CallCollisionEvents(persisted[i]);
+    }
+
+    for (const ContactEvent& event : removed)
+    {
+        uint64_t pair = ((uint64_t)event.body1.GetIndexAndSequenceNumber() << 32) |
+                        event.body2.GetIndexAndSequenceNumber();
+
+        // Pairs that were already touching when a callback was added were never counted
+        auto it = touchingSubShapes.find(pair);
+        if (it == touchingSubShapes.end())
+            continue;
+
+        if (--it->second == 0)
+        {
+            touchingSubShapes.erase(it);
+            CallCollisionEvents(event);
+        }
+    }
+}
+
+// Records contact events for the bodies that have callbacks, they're called once the step is over
 class MyContactListener : public JPH::ContactListener
 {
   public:
@@ -294,21 +1147,479 @@ class MyContactListener : public JPH::ContactListener
                                 const JPH::ContactManifold& manifold,
                                 JPH::ContactSettings&       settings) override
     {
-        for (const auto& data : registeredCollisions)
+        CountContact(body1.GetID(), body2.GetID());
+        RecordContactEvent(ContactEventType::Added, body1.GetID(), body2.GetID());
+    }
+
+    // Called every step that two bodies keep colliding
+    virtual void OnContactPersisted(const JPH::Body& body1, const JPH::Body& body2,
+                                    const JPH::ContactManifold& manifold,
+                                    JPH::ContactSettings&       settings) override
+    {
+        CountContact(body1.GetID(), body2.GetID());
+        RecordContactEvent(ContactEventType::Persisted, body1.GetID(), body2.GetID());
+    }
+
+    // Called when two bodies stop colliding, the bodies can't be touched here
+    virtual void OnContactRemoved(const JPH::SubShapeIDPair& subShapePair) override
+    {
+        RecordContactEvent(ContactEventType::Removed, subShapePair.GetBody1ID(),
+                           subShapePair.GetBody2ID());
+    }
+};
+
+// Snapshots of the simulation for resetting test scenarios and rolling back. Only the dynamic
+// bodies are saved, static bodies never move and kinematic ones are moved by game code. Contacts
+// and constraints are saved as well, so the simulation carries on from a snapshot like it did the
+// first time. Snapshots are kept in a ring buffer and have to be saved and restored between steps
+
+inline unsigned int cMaxPhysicsSnapshots = 64; // Snapshots kept before the oldest is overwritten
+
+// State recorder that keeps its buffer between saves, so saving over an old snapshot doesn't
+// allocate once the buffer is big enough
+class SnapshotRecorder final : public JPH::StateRecorder
+{
+  public:
+    virtual void WriteBytes(const void* data, size_t size) override
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    virtual void ReadBytes(void* data, size_t size) override
+    {
+        if (readPosition + size > buffer.size())
+        {
+            std::memset(data, 0, size);
+            failed = true;
+            return;
+        }
+
+        std::memcpy(data, buffer.data() + readPosition, size);
+        readPosition += size;
+    }
+
+    virtual bool IsEOF() const override { return readPosition >= buffer.size(); }
+    virtual bool IsFailed() const override { return failed; }
+
+    void Clear()
+    {
+        buffer.clear();
+        Rewind();
+    }
+
+    void Rewind()
+    {
+        readPosition = 0;
+        failed = false;
+    }
+
+    size_t GetSize() const { return buffer.size(); }
+
+  private:
+    std::vector<uint8_t> buffer;
+    size_t               readPosition = 0;
+    bool                 failed = false;
+};
+
+// Lets only dynamic bodies into a snapshot and keeps a list of them, so their transforms can be
+// synced after it's restored
+class DynamicBodyFilter final : public JPH::StateRecorderFilter
+{
+  public:
+    explicit DynamicBodyFilter(std::vector<JPH::BodyID>& bodies) : bodies(bodies) {}
+
+    virtual bool ShouldSaveBody(const JPH::Body& body) const override
+    {
+        if (!body.IsDynamic())
+            return false;
+
+        bodies.push_back(body.GetID());
+        return true;
+    }
+
+  private:
+    std::vector<JPH::BodyID>& bodies;
+};
+
+struct PhysicsSnapshot
+{
+    uint64_t                          id = 0; // Zero for a slot that hasn't been used yet
+    SnapshotRecorder                  recorder;
+    std::vector<JPH::BodyID>          bodies;            // The dynamic bodies that were saved
+    std::unordered_map<uint64_t, int> touchingSubShapes; // So collision events carry on from it
+};
+
+inline std::vector<PhysicsSnapshot> physicsSnapshots;
+inline uint64_t                     nextSnapshotId = 1;
+
+// Saves a snapshot and returns its id, the oldest snapshot is overwritten once there are
+// cMaxPhysicsSnapshots of them
+inline uint64_t SavePhysicsSnapshot()
+{
+    if (physicsSnapshots.size() != cMaxPhysicsSnapshots)
+    {
+        physicsSnapshots.clear();
+        physicsSnapshots.resize(cMaxPhysicsSnapshots);
+    }
+
+    uint64_t         id = nextSnapshotId++;
+    PhysicsSnapshot& snapshot = physicsSnapshots[id % physicsSnapshots.size()];
+    snapshot.id = id;
+    snapshot.recorder.Clear();
+    snapshot.bodies.clear();
+
+    DynamicBodyFilter filter(snapshot.bodies);
+    physicsSystem.SaveState(snapshot.recorder, JPH::EStateRecorderState::All, &filter);
+    snapshot.touchingSubShapes = touchingSubShapes;
+
+    return id;
+}
+
+// Returns the snapshot with the id, or nullptr if it has been overwritten or dropped
+inline PhysicsSnapshot* FindPhysicsSnapshot(uint64_t id)
+{
+    if (id == 0 || id >= nextSnapshotId || physicsSnapshots.empty())
+        return nullptr;
+
+    PhysicsSnapshot& snapshot = physicsSnapshots[id % physicsSnapshots.size()];
+    return snapshot.id == id ? &snapshot : nullptr;
+}
+
+// Puts the simulation back to how it was when the snapshot was saved and returns the snapshot, or
+// nullptr if it couldn't. The simulation goes on from the snapshot, so snapshots saved after it are
+// dropped. Bodies created since keep their state, and it fails without changing anything if a
+// saved body has been removed since. It doesn't touch the Transforms, RestoreSnapshot does that
+inline const PhysicsSnapshot* RestorePhysicsSnapshot(uint64_t id)
+{
+    PhysicsSnapshot* snapshot = FindPhysicsSnapshot(id);
+    if (snapshot == nullptr)
+    {
+        std::cerr << "ERROR: Physics snapshot " << id << " doesn't exist anymore" << std::endl;
+        return nullptr;
+    }
+
+    for (JPH::BodyID body : snapshot->bodies)
+    {
+        if (!bodyInterface.IsAdded(body))
+        {
+            std::cerr << "ERROR: Can't restore physics snapshot " << id
+                      << ", a body in it has been removed" << std::endl;
+            return nullptr;
+        }
+    }
+
+    snapshot->recorder.Rewind();
+    if (!physicsSystem.RestoreState(snapshot->recorder) || snapshot->recorder.IsFailed())
+    {
+        std::cerr << "ERROR: Failed to restore physics snapshot " << id << std::endl;
+        return nullptr;
+    }
+
+    touchingSubShapes = snapshot->touchingSubShapes;
+
+    // Ids are never handed out twice, so an id saved after this one can't find another snapshot
+    for (PhysicsSnapshot& newer : physicsSnapshots)
+    {
+        if (newer.id > id)
+        {
+            newer.id = 0;
+        }
+    }
+
+    return snapshot;
+}
+
+// Batched scene queries, for things like AI doing hundreds of line of sight checks a frame. Each
+// batch is split into jobs on the physics job system and the results are written into arrays that
+// are only resized when they're too small, so a query doesn't allocate. They read the bodies
+// without locking, so they must be run between physics steps
+
+inline constexpr uint32_t cAllLayers = 0xFFFFFFFFu; // Layer mask that lets a query hit every layer
+
+inline unsigned int cMinQueriesPerJob = 32; // Fewest queries a job gets before a batch is split
+
+// Bit n of a query's layer mask lets it hit bodies in object layer n
+inline uint32_t LayerBit(JPH::ObjectLayer layer)
+{
+    return 1u << layer;
+}
+
+// Lets queries through to the object layers in a mask
+class QueryObjectLayerFilter final : public JPH::ObjectLayerFilter
+{
+  public:
+    explicit QueryObjectLayerFilter(uint32_t layerMask) : layerMask(layerMask) {}
+
+    virtual bool ShouldCollide(JPH::ObjectLayer layer) const override
+    {
+        return (layerMask & LayerBit(layer)) != 0;
+    }
+
+  private:
+    uint32_t layerMask;
+};
+
+// Lets queries into the broadphase trees of the object layers in a mask, so a query for moving
+// bodies doesn't walk the tree of the static ones
+class QueryBroadPhaseLayerFilter final : public JPH::BroadPhaseLayerFilter
+{
+  public:
+    explicit QueryBroadPhaseLayerFilter(uint32_t layerMask)
+    {
+        BPLayerInterfaceImpl layerInterface;
+        for (JPH::ObjectLayer layer = 0; layer < Layers::NUM_LAYERS; ++layer)
         {
-            if (body1.GetID() == data.id->GetID() || body2.GetID() == data.id->GetID())
+            if ((layerMask & LayerBit(layer)) != 0)
             {
-                data.call(&body1, &body2);
+                JPH::BroadPhaseLayer broadPhaseLayer = layerInterface.GetBroadPhaseLayer(layer);
+                broadPhaseMask |= 1u << (JPH::BroadPhaseLayer::Type)broadPhaseLayer;
             }
         }
     }
 
-    // Called when two bodies stop colliding
-    virtual void OnContactRemoved(const JPH::SubShapeIDPair& subShapePair) override
+    virtual bool ShouldCollide(JPH::BroadPhaseLayer layer) const override
     {
-        // for (auto data : registeredDecollisions)
-        //{
-        //     data.call(subShapePair.GetBody1ID(), subShapePair.GetBody2ID());
-        // }
+        return (broadPhaseMask & (1u << (JPH::BroadPhaseLayer::Type)layer)) != 0;
     }
+
+  private:
+    uint32_t broadPhaseMask = 0;
+};
+
+// A ray from origin to origin + direction
+struct RaycastQuery
+{
+    JPH::RVec3 origin;
+    JPH::Vec3  direction;
+    uint32_t   layerMask = cAllLayers;
+};
+
+// A sphere swept from origin to origin + direction
+struct SphereCastQuery
+{
+    JPH::RVec3 origin;
+    JPH::Vec3  direction;
+    float      radius = 0.5f;
+    uint32_t   layerMask = cAllLayers;
 };
+
+// A box that finds the bodies whose shapes overlap it
+struct OverlapBoxQuery
+{
+    JPH::RVec3 center;
+    JPH::Vec3  halfExtent;
+    JPH::Quat  rotation = JPH::Quat::sIdentity();
+    uint32_t   layerMask = cAllLayers;
+};
+
+// The closest body a ray or sphere cast ran into
+struct QueryHit
+{
+    JPH::BodyID body;             // Invalid if the query didn't hit anything
+    float       fraction = 1.0f;  // How far along the direction the hit is, from 0 to 1
+    JPH::RVec3  point;            // Where the query touched the body
+    JPH::Vec3   normal;           // Surface normal of the body at the point
+};
+
+// Runs count queries split into jobs on the physics job system, runQuery(i) runs query i. Runs them
+// on the calling thread if there are too few to be worth splitting
+template <typename RunQuery> inline void RunQueryBatch(size_t count, RunQuery runQuery)
+{
+    size_t jobCount = std::min((size_t)jobSystem->GetMaxConcurrency(),
+                               count / std::max(cMinQueriesPerJob, 1u));
+    if (jobCount <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            runQuery(i);
+        }
+
+        return;
+    }
+
+    JPH::JobSystem::Barrier* barrier = jobSystem->CreateBarrier();
+
+    size_t perJob = (count + jobCount - 1) / jobCount;
+    for (size_t first = 0; first < count; first += perJob)
+    {
+        size_t last = std::min(first + perJob, count);
+
+        JPH::JobHandle job = jobSystem->CreateJob("Physics Queries", JPH::Color::sGreen,
+                                                  [first, last, &runQuery]()
+                                                  {
+                                                      for (size_t i = first; i < last; ++i)
+                                                      {
+                                                          runQuery(i);
+                                                      }
+                                                  });
+        barrier->AddJob(job);
+    }
+
+    jobSystem->WaitForJobs(barrier);
+    jobSystem->DestroyBarrier(barrier);
+}
+
+// Casts every ray in parallel, hits[i] is the closest hit of rays[i]
+inline void RaycastBatch(const std::vector<RaycastQuery>& rays, std::vector<QueryHit>& hits)
+{
+    hits.resize(rays.size());
+
+    const JPH::NarrowPhaseQuery&        query = physicsSystem.GetNarrowPhaseQueryNoLock();
+    const JPH::BodyLockInterfaceNoLock& bodies = physicsSystem.GetBodyLockInterfaceNoLock();
+
+    RunQueryBatch(rays.size(),
+                  [&](size_t i)
+                  {
+                      const RaycastQuery& ray = rays[i];
+                      QueryHit&           hit = hits[i];
+                      hit = QueryHit();
+
+                      QueryBroadPhaseLayerFilter broadPhaseFilter(ray.layerMask);
+                      QueryObjectLayerFilter     objectFilter(ray.layerMask);
+
+                      JPH::RRayCast       cast(ray.origin, ray.direction);
+                      JPH::RayCastResult result;
+                      if (!query.CastRay(cast, result, broadPhaseFilter, objectFilter))
+                          return;
+
+                      hit.body = result.mBodyID;
+                      hit.fraction = result.mFraction;
+                      hit.point = cast.GetPointOnRay(result.mFraction);
+
+                      const JPH::Body* body = bodies.TryGetBody(result.mBodyID);
+                      if (body != nullptr)
+                      {
+                          hit.normal = body->GetWorldSpaceSurfaceNormal(result.mSubShapeID2,
+                                                                        hit.point);
+                      }
+                  });
+}
+
+// Casts every sphere in parallel, hits[i] is the closest hit of spheres[i]. Spheres that start
+// inside a body hit it with a fraction of zero
+inline void SphereCastBatch(const std::vector<SphereCastQuery>& spheres,
+                            std::vector<QueryHit>&              hits)
+{
+    hits.resize(spheres.size());
+
+    const JPH::NarrowPhaseQuery& query = physicsSystem.GetNarrowPhaseQueryNoLock();
+
+    RunQueryBatch(spheres.size(),
+                  [&](size_t i)
+                  {
+                      const SphereCastQuery& sphere = spheres[i];
+                      QueryHit&              hit = hits[i];
+                      hit = QueryHit();
+
+                      if (!(sphere.radius > 0.0f))
+                          return;
+
+                      // Built on the stack with the exact radius, the shape cache is only for
+                      // rigidbodies and would keep every size a query ever used
+                      JPH::SphereShape shape(sphere.radius);
+                      shape.SetEmbedded();
+
+                      QueryBroadPhaseLayerFilter broadPhaseFilter(sphere.layerMask);
+                      QueryObjectLayerFilter     objectFilter(sphere.layerMask);
+
+                      JPH::RShapeCast cast = JPH::RShapeCast::sFromWorldTransform(
+                          &shape, JPH::Vec3::sReplicate(1.0f),
+                          JPH::RMat44::sTranslation(sphere.origin), sphere.direction);
+
+                      JPH::ShapeCastSettings settings;
+                      JPH::ClosestHitCollisionCollector<JPH::CastShapeCollector> collector;
+
+                      // The results are relative to the sphere's origin so they stay precise
+                      query.CastShape(cast, settings, sphere.origin, collector, broadPhaseFilter,
+                                      objectFilter);
+                      if (!collector.HadHit())
+                          return;
+
+                      const JPH::ShapeCastResult& result = collector.mHit;
+                      hit.body = result.mBodyID2;
+                      hit.fraction = result.mFraction;
+                      hit.point = sphere.origin + result.mContactPointOn2;
+                      hit.normal = -result.mPenetrationAxis.NormalizedOr(JPH::Vec3::sZero());
+                  });
+}
+
+// Collects up to a fixed number of distinct bodies into a slice of a result array
+class OverlapCollector final : public JPH::CollideShapeCollector
+{
+  public:
+    OverlapCollector(JPH::BodyID* bodies, int capacity) : bodies(bodies), capacity(capacity) {}
+
+    virtual void AddHit(const JPH::CollideShapeResult& result) override
+    {
+        // A body with many sub shapes like a mesh is hit once for each of them
+        for (int i = 0; i < count; ++i)
+        {
+            if (bodies[i] == result.mBodyID2)
+                return;
+        }
+
+        bodies[count++] = result.mBodyID2;
+        if (count == capacity)
+        {
+            ForceEarlyOut();
+        }
+    }
+
+    int count = 0;
+
+  private:
+    JPH::BodyID* bodies;
+    int          capacity;
+};
+
+// Finds the bodies overlapping every box in parallel. The bodies that boxes[i] overlaps are
+// bodies[i * maxBodies] to bodies[i * maxBodies + counts[i] - 1], a box stops looking once it has
+// found maxBodies of them. A maxBodies of zero or less finds nothing
+inline void OverlapBoxBatch(const std::vector<OverlapBoxQuery>& boxes, int maxBodies,
+                            std::vector<JPH::BodyID>& bodies, std::vector<int>& counts)
+{
+    counts.resize(boxes.size());
+
+    // Sizing the results with a negative count would ask for an enormous array
+    if (maxBodies <= 0)
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        bodies.clear();
+        return;
+    }
+
+    bodies.resize(boxes.size() * (size_t)maxBodies);
+
+    const JPH::NarrowPhaseQuery& query = physicsSystem.GetNarrowPhaseQueryNoLock();
+
+    RunQueryBatch(boxes.size(),
+                  [&](size_t i)
+                  {
+                      const OverlapBoxQuery& box = boxes[i];
+                      counts[i] = 0;
+
+                      if (!(box.halfExtent.ReduceMin() >= 0.0f))
+                          return;
+
+                      // Built on the stack with the exact size too, the convex radius has to fit
+                      // inside boxes thinner than the default one
+                      JPH::BoxShape shape(box.halfExtent,
+                                          std::min(JPH::cDefaultConvexRadius,
+                                                   box.halfExtent.ReduceMin()));
+                      shape.SetEmbedded();
+
+                      QueryBroadPhaseLayerFilter broadPhaseFilter(box.layerMask);
+                      QueryObjectLayerFilter     objectFilter(box.layerMask);
+
+                      JPH::CollideShapeSettings settings;
+                      OverlapCollector          collector(&bodies[i * maxBodies], maxBodies);
+
+                      query.CollideShape(&shape, JPH::Vec3::sReplicate(1.0f),
+                                         JPH::RMat44::sRotationTranslation(box.rotation,
+                                                                           box.center),
+                                         settings, box.center, collector, broadPhaseFilter,
+                                         objectFilter);
+                      counts[i] = collector.count;
+                  });
+}
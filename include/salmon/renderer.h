@@ -43,7 +43,7 @@ namespace Renderer
 // Intializes OpenGL
 void Init(bool depth = true, bool ui = true);
 
-// Makes a 4x4 matrix from a transform component
+// Makes a 4x4 matrix from a transform component, or returns its modelMat if useMatrix is set
 glm::mat4 MakeModelTransform(Transform* trans);
 
 // Takes an entityID, gets its Transform and MeshRenderer components
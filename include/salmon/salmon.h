@@ -16,9 +16,8 @@
     JPH_IF_ENABLE_ASSERTS(JPH::AssertFailed = AssertFailedImpl;)                                                          \
     JPH::Factory::sInstance = new JPH::Factory();                                                                    \
     JPH::RegisterTypes();                                                                                            \
-    tempAllocator = new JPH::TempAllocatorImpl(200 * 1024 * 1024);                                                   \
-    jobSystem = new JPH::JobSystemThreadPool(JPH::cMaxPhysicsJobs, JPH::cMaxPhysicsBarriers,                         \
-                                             JPH::thread::hardware_concurrency() - 1);                               \
+    tempAllocator = new TrackingTempAllocator(200 * 1024 * 1024);                                                    \
+    jobSystem = &GetJobSystem();                                                                                     \
     BPLayerInterfaceImpl broadPhaseLayerInterface;                                                                   \
     ObjectVsBroadPhaseLayerFilterImpl objectVsBroadphaseLayerFilter;                                                 \
     ObjectLayerPairFilterImpl objectVsObjectLayerFilter;                                                             \
@@ -50,5 +49,7 @@
 #include <sm2d/types.h>
 #include <sm2d/functions.h>
 #include <sm2d/colliders.h>
+#include <sm2d/solver.h>
+#include <sm2d/world.h>
 #include <salmon/clock.h>
 #include <salmon/sprite_animation.h>
@@ -4,6 +4,7 @@
 #include <salmon/sound_buffer.h>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 class SoundSource : public std::enable_shared_from_this<SoundSource>
 {
@@ -12,7 +13,7 @@ class SoundSource : public std::enable_shared_from_this<SoundSource>
     ~SoundSource();
 
     void Play(const Sound sound);
-    void MonitorPlayback();
+    bool IsPlaying() const;
 
     float p_Pitch = 1.f;
     float p_Gain = 1.f;
@@ -24,3 +25,7 @@ class SoundSource : public std::enable_shared_from_this<SoundSource>
     ALuint p_Source;
     ALuint p_Buffer = 0;
 };
+
+// Sources that are playing, each one is kept alive until its sound has finished even if nothing
+// else holds on to it. SoundSourceSys drops the finished ones every frame
+inline std::vector<std::shared_ptr<SoundSource>> playingSources;
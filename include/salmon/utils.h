@@ -18,6 +18,10 @@ namespace Utils
 // Loads a texture using stb_image and returns an OpenGL texture identifier
 unsigned int LoadTexture(const char* path);
 
+// Loads several textures at once, textures[i] is the texture of paths[i]. The files are decoded in
+// parallel on the job system and then uploaded one by one on the calling thread
+void LoadTextures(const std::vector<const char*>& paths, std::vector<unsigned int>& textures);
+
 // Generates a random floating point value within a range.
 // The generated number can be the minimum, but it won't be the maximum
 float GenerateRandomNumber(float min, float max);
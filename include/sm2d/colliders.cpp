@@ -4,11 +4,93 @@
 #include <cmath>
 #include <cassert>
 #include <glm/gtx/string_cast.hpp>
+#include <cfloat>
 #include <limits>
+#include <iostream>
 
 namespace sm2d
 {
 
+ColPolygon CheckPolygon(const ColPolygon& poly)
+{
+    int count = (int)poly.points.size();
+    if (count > SM_MAX_POLYGON_VERTICES)
+    {
+        std::cerr << "ERROR: sm2d polygon colliders can have up to " << SM_MAX_POLYGON_VERTICES
+                  << " points, this one has " << count << ", only the first "
+                  << SM_MAX_POLYGON_VERTICES << " are used" << std::endl;
+
+        // The first points of a convex polygon still make a convex polygon
+        ColPolygon clamped = poly;
+        clamped.points.resize(SM_MAX_POLYGON_VERTICES);
+        return clamped;
+    }
+
+    if (count < 3)
+    {
+        std::cerr << "ERROR: sm2d polygon colliders need at least 3 points, this one has "
+                  << count << ", it's replaced by a tiny square" << std::endl;
+
+        glm::vec2 center = count > 0 ? poly.points[0] : glm::vec2(0.0f);
+        float     size = SM_LINEAR_SLOP;
+
+        ColPolygon square = poly;
+        square.points = {center + glm::vec2(-size, -size), center + glm::vec2(size, -size),
+                         center + glm::vec2(size, size), center + glm::vec2(-size, size)};
+        return square;
+    }
+
+    return poly;
+}
+
+void InitPolygon(ColPolygon& poly)
+{
+    int count = (int)poly.points.size();
+    BuildPolygonSoA(poly.local, poly.points.data(), count);
+    poly.worldPoints.resize(count);
+
+    // Triangles fanning out from the body's origin, the sums are signed so either winding works
+    glm::vec2 center = glm::vec2(0.0f);
+    float     area = 0.0f;
+    float     inertia = 0.0f;
+
+    for (int i = 0; i < count; ++i)
+    {
+        glm::vec2 p1 = poly.points[i];
+        glm::vec2 p2 = poly.points[(i + 1) % count];
+
+        float cross = CrossProduct(p1, p2);
+        float triangleArea = 0.5f * cross;
+        area += triangleArea;
+        center += triangleArea * (p1 + p2) / 3.0f;
+
+        float integralX = p1.x * p1.x + p2.x * p1.x + p2.x * p2.x;
+        float integralY = p1.y * p1.y + p2.y * p1.y + p2.y * p2.y;
+        inertia += (0.25f / 3.0f) * cross * (integralX + integralY);
+    }
+
+    assert(std::abs(area) > FLT_EPSILON);
+    poly.localCenter = center / area;
+    poly.area = std::abs(area);
+    poly.inertia = std::abs(inertia);
+}
+
+void InitSegment(ColSegment& segment)
+{
+    glm::vec2 edge = segment.point2 - segment.point1;
+    assert(glm::dot(edge, edge) > FLT_EPSILON);
+
+    // The solid side is on the left, so the normal is the edge turned clockwise
+    glm::vec2 direction = glm::normalize(edge);
+    segment.localNormal = glm::vec2(direction.y, -direction.x);
+
+    // Turning left at a point makes a corner that sticks out into the free side
+    glm::vec2 previous = glm::normalize(segment.point1 - segment.ghost1);
+    glm::vec2 next = glm::normalize(segment.ghost2 - segment.point2);
+    segment.convex1 = CrossProduct(previous, direction) > FLT_EPSILON;
+    segment.convex2 = CrossProduct(direction, next) > FLT_EPSILON;
+}
+
 Manifold TestColAABBAABB(const Collider& a, const Collider& b)
 {
     Manifold result = {};
@@ -158,112 +240,197 @@ Manifold TestColAABBCircle(const Collider& aabb, const Collider& circle)
     return result;
 }
 
-Manifold TestColPolygonPolygon(Collider& a, Collider& b)
+// A point of the incident edge while it's being clipped, id tracks which features made it
+struct ClipVertex
 {
-    Manifold result = {};
-    result.colliding = false;
-    Collider* col1 = &a;
-    Collider* col2 = &b;
+    glm::vec2 point;
+    uint32_t  id;
+};
 
-    float     minOverlap = std::numeric_limits<float>::max();
-    glm::vec2 minAxis;
+// Sutherland-Hodgman clipping of a segment against the half plane dot(normal, x) <= offset
+static int ClipSegmentToLine(ClipVertex out[2], const ClipVertex in[2], const glm::vec2& normal,
+                             float offset, uint32_t clipId)
+{
+    int count = 0;
+
+    float distance0 = glm::dot(normal, in[0].point) - offset;
+    float distance1 = glm::dot(normal, in[1].point) - offset;
 
-    if (col1 == col2)
+    if (distance0 <= 0.0f)
     {
-        return result;
+        out[count++] = in[0];
+    }
+    if (distance1 <= 0.0f)
+    {
+        out[count++] = in[1];
     }
 
-    for (int shape = 0; shape < 2; ++shape)
+    // The points are on different sides of the plane, the crossing point is a new vertex
+    if (distance0 * distance1 < 0.0f)
     {
-        if (shape == 1)
-        {
-            col1 = &b;
-            col2 = &a;
-        }
+        float t = distance0 / (distance0 - distance1);
+        out[count].point = in[0].point + t * (in[1].point - in[0].point);
+        out[count].id = clipId;
+        count++;
+    }
+
+    return count;
+}
 
-        for (int a2 = 0; a2 < col1->polygon.worldPoints.size(); a2++)
+// The incident edge is the one on the polygon that faces the reference edge the most, its points
+// go in incidentPoints and its index is returned
+static int FindIncidentEdge(ClipVertex incidentPoints[2], const PolygonSoA& incident,
+                            const glm::vec2& referenceNormal, int referenceEdge, bool flip)
+{
+    int   incidentEdge = 0;
+    float minDot = FLT_MAX;
+    for (int i = 0; i < incident.count; ++i)
+    {
+        float dot =
+            referenceNormal.x * incident.normalX[i] + referenceNormal.y * incident.normalY[i];
+        if (dot < minDot)
         {
-            int b = (a2 + 1) % col1->polygon.worldPoints.size();
-
-            glm::vec2 axisProj = {
-                -(col1->polygon.worldPoints[b].y - col1->polygon.worldPoints[a2].y),
-                col1->polygon.worldPoints[b].x - col1->polygon.worldPoints[a2].x};
-            axisProj = glm::normalize(axisProj);
-
-            float min1 = INFINITY;
-            float max1 = -INFINITY;
-            for (int p = 0; p < col1->polygon.worldPoints.size(); ++p)
-            {
-                float q = glm::dot(col1->polygon.worldPoints[p], axisProj);
-                min1 = std::min(min1, q);
-                max1 = std::max(max1, q);
-            }
-
-            float min2 = INFINITY;
-            float max2 = -INFINITY;
-            for (int p = 0; p < col2->polygon.worldPoints.size(); ++p)
-            {
-                float q = glm::dot(col2->polygon.worldPoints[p], axisProj);
-                min2 = std::min(min2, q);
-                max2 = std::max(max2, q);
-            }
-
-            // Calculate overlap
-            float overlap = std::min(max1, max2) - std::max(min1, min2);
-
-            // Track the smallest overlap and corresponding axis
-            if (overlap < minOverlap)
-            {
-                minOverlap = overlap;
-                minAxis = axisProj;
-            }
-
-            if (!(max2 >= min1 && max1 >= min2))
-                return result;
+            minDot = dot;
+            incidentEdge = i;
         }
     }
 
-    result.colliding = true;
-    result.objectA = &a;
-    result.objectB = &b;
-    result.penetrationDepth = minOverlap;
+    int incidentNext = (incidentEdge + 1) % incident.count;
 
-    // Contact point detection here
-    std::vector<glm::vec2> intersections;
+    incidentPoints[0].point = glm::vec2(incident.x[incidentEdge], incident.y[incidentEdge]);
+    incidentPoints[0].id = SM_MAKE_FEATURE_ID(referenceEdge, incidentEdge, 0, flip);
+    incidentPoints[1].point = glm::vec2(incident.x[incidentNext], incident.y[incidentNext]);
+    incidentPoints[1].id = SM_MAKE_FEATURE_ID(referenceEdge, incidentNext, 0, flip);
 
-    size_t col1Size = col1->polygon.worldPoints.size();
-    size_t col2Size = col2->polygon.worldPoints.size();
+    return incidentEdge;
+}
 
-    for (size_t i = 0; i < col1Size; ++i)
+// Clips the incident edge against the side planes of the reference edge from v11 to v12, the
+// points left behind the reference edge become contact points halfway between the surfaces.
+// Returns how many contact points were added to the manifold
+static int ClipIncidentEdge(Manifold& result, const ClipVertex incidentPoints[2],
+                            const glm::vec2& v11, const glm::vec2& v12,
+                            const glm::vec2& referenceNormal, int referenceEdge, int incidentEdge,
+                            bool flip)
+{
+    // The reference normal turned a quarter is the edge direction, which way depends on the winding
+    glm::vec2 tangent = glm::vec2(referenceNormal.y, -referenceNormal.x);
+    if (glm::dot(tangent, v12 - v11) < 0.0f)
     {
-        glm::vec2 p0 = col1->polygon.worldPoints[i];
-        glm::vec2 p1 = col1->polygon.worldPoints[(i + 1) % col1Size];
+        tangent = -tangent;
+    }
+
+    // Clip the incident edge against the side planes of the reference edge
+    ClipVertex clipped1[2];
+    ClipVertex clipped2[2];
+
+    if (ClipSegmentToLine(clipped1, incidentPoints, -tangent, -glm::dot(tangent, v11),
+                          SM_MAKE_FEATURE_ID(referenceEdge, incidentEdge, 1, flip)) < 2)
+        return 0;
 
-        for (size_t j = 0; j < col2Size; ++j)
+    if (ClipSegmentToLine(clipped2, clipped1, tangent, glm::dot(tangent, v12),
+                          SM_MAKE_FEATURE_ID(referenceEdge, incidentEdge, 2, flip)) < 2)
+        return 0;
+
+    // Keep the points that are behind the reference edge, they sit halfway between the surfaces
+    for (int i = 0; i < 2; ++i)
+    {
+        float separation = glm::dot(referenceNormal, clipped2[i].point - v11);
+        if (separation <= 0.0f)
         {
-            glm::vec2 q0 = col2->polygon.worldPoints[j];
-            glm::vec2 q1 = col2->polygon.worldPoints[(j + 1) % col2Size];
-
-            auto intersection = GetLineIntersection(p0, p1, q0, q1);
-            if (intersection)
-            {
-                intersections.push_back(*intersection);
-            }
+            ContactPoint& contact = result.points[result.pointCount++];
+            contact.point = clipped2[i].point - 0.5f * separation * referenceNormal;
+            contact.separation = separation;
+            contact.id = clipped2[i].id;
         }
     }
 
-    if (!intersections.empty())
+    return result.pointCount;
+}
+
+// Marks a manifold with contact points as colliding, normal points from A to B
+static void FinishManifold(Manifold& result, const glm::vec2& normal, float penetrationDepth)
+{
+    result.colliding = true;
+    result.collisionNormal = normal;
+    result.penetrationDepth = penetrationDepth;
+
+    result.contactPoint = result.points[0].point;
+    if (result.pointCount == 2)
+    {
+        result.contactPoint = 0.5f * (result.points[0].point + result.points[1].point);
+    }
+}
+
+// Separating axis test followed by clipping the incident edge against the reference edge, all on
+// the stack. Fills in everything in the manifold apart from the colliders
+static void CollidePolygons(Manifold& result, const PolygonSoA& polyA, const PolygonSoA& polyB)
+{
+    result.colliding = false;
+    result.pointCount = 0;
+
+    int   edgeA = 0;
+    float separationA = FindMaxSeparation(edgeA, polyA, polyB);
+    if (separationA > 0.0f)
+        return;
+
+    int   edgeB = 0;
+    float separationB = FindMaxSeparation(edgeB, polyB, polyA);
+    if (separationB > 0.0f)
+        return;
+
+    // The polygon with the largest separation owns the reference edge, A is preferred when they're
+    // about the same so the choice doesn't flicker between frames
+    const PolygonSoA* reference = &polyA;
+    const PolygonSoA* incident = &polyB;
+    int               referenceEdge = edgeA;
+    bool              flip = false;
+
+    const float tolerance = 0.1f * SM_LINEAR_SLOP;
+    if (separationB > separationA + tolerance)
     {
-        glm::vec2 centroid(0.0f);
-        for (const auto& point : intersections) { centroid += point; }
-        result.contactPoint = centroid / static_cast<float>(intersections.size());
+        reference = &polyB;
+        incident = &polyA;
+        referenceEdge = edgeB;
+        flip = true;
     }
 
+    glm::vec2 referenceNormal =
+        glm::vec2(reference->normalX[referenceEdge], reference->normalY[referenceEdge]);
+
+    ClipVertex incidentPoints[2];
+    int        incidentEdge =
+        FindIncidentEdge(incidentPoints, *incident, referenceNormal, referenceEdge, flip);
+
+    int       referenceNext = (referenceEdge + 1) % reference->count;
+    glm::vec2 v11 = glm::vec2(reference->x[referenceEdge], reference->y[referenceEdge]);
+    glm::vec2 v12 = glm::vec2(reference->x[referenceNext], reference->y[referenceNext]);
+
+    if (ClipIncidentEdge(result, incidentPoints, v11, v12, referenceNormal, referenceEdge,
+                         incidentEdge, flip) == 0)
+        return;
+
     // Ensure normal points from A to B
-    result.collisionNormal = minAxis;
-    if (glm::dot(result.collisionNormal, b.polygon.center - a.polygon.center) < 0)
+    FinishManifold(result, flip ? -referenceNormal : referenceNormal,
+                   -MaxFloat(separationA, separationB));
+}
+
+Manifold TestColPolygonPolygon(Collider& a, Collider& b)
+{
+    Manifold result = {};
+    result.colliding = false;
+
+    if (&a == &b)
+    {
+        return result;
+    }
+
+    CollidePolygons(result, a.polygon.world, b.polygon.world);
+
+    if (result.colliding)
     {
-        result.collisionNormal = -result.collisionNormal;
+        result.objectA = &a;
+        result.objectB = &b;
     }
 
     return result;
@@ -274,123 +441,313 @@ Manifold TestColAABBPolygon(Collider& aabb, Collider& poly)
     Manifold result = {};
     result.colliding = false;
 
-    ColPolygon a;
-    a.center = glm::vec2(aabb.body->transform->position);
-    ComputeAABBPoints(aabb, a.worldPoints);
-    ColPolygon* col1 = &a;
-    ColPolygon* col2 = &poly.polygon;
+    PolygonSoA box;
+    ComputeAABBPolygon(aabb, box);
 
-    float     minOverlap = std::numeric_limits<float>::max();
-    glm::vec2 minAxis;
+    CollidePolygons(result, box, poly.polygon.world);
 
-    if (col1 == col2)
+    if (result.colliding)
     {
-        return result;
+        result.objectA = &aabb;
+        result.objectB = &poly;
     }
 
-    for (int shape = 0; shape < 2; ++shape)
+    return result;
+}
+
+Manifold TestColCirclePolygon(const Collider& circle, const Collider& poly)
+{
+    // FIXME
+    Manifold result;
+    result.colliding = false;
+
+    return result;
+}
+
+// The normal of the edge from point a to point b of a chain
+static glm::vec2 ChainEdgeNormal(const glm::vec2& a, const glm::vec2& b)
+{
+    glm::vec2 direction = glm::normalize(b - a);
+    return glm::vec2(direction.y, -direction.x);
+}
+
+// A contact normal is usable if it's between the segment's normal and the normals of the
+// neighbours it turns towards at convex corners. At flat and concave corners that leaves only the
+// segment's own normal, which is what keeps shapes from catching on the seams
+static bool IsAdmissibleNormal(const ColSegment& segment, const glm::vec2& normal)
+{
+    // Sine of how far past a limit a normal can be, makes up for rounding
+    const float tolerance = 0.005f;
+
+    if (CrossProduct(segment.normal, normal) >= 0.0f)
     {
-        if (shape == 1)
-        {
-            col1 = &poly.polygon;
-            col2 = &a;
-        }
+        glm::vec2 limit = segment.convex2
+                              ? ChainEdgeNormal(segment.worldPoint2, segment.worldGhost2)
+                              : segment.normal;
+        return CrossProduct(normal, limit) >= -tolerance &&
+               glm::dot(normal, segment.normal + limit) > 0.0f;
+    }
 
-        for (int a2 = 0; a2 < col1->worldPoints.size(); a2++)
-        {
-            int b = (a2 + 1) % col1->worldPoints.size();
-
-            glm::vec2 axisProj = {-(col1->worldPoints[b].y - col1->worldPoints[a2].y),
-                                  col1->worldPoints[b].x - col1->worldPoints[a2].x};
-
-            float min1 = INFINITY;
-            float max1 = -INFINITY;
-            for (int p = 0; p < col1->worldPoints.size(); ++p)
-            {
-                float q = glm::dot(col1->worldPoints[p], axisProj);
-                min1 = std::min(min1, q);
-                max1 = std::max(max1, q);
-            }
-
-            float min2 = INFINITY;
-            float max2 = -INFINITY;
-            for (int p = 0; p < col2->worldPoints.size(); ++p)
-            {
-                float q = glm::dot(col2->worldPoints[p], axisProj);
-                min2 = std::min(min2, q);
-                max2 = std::max(max2, q);
-            }
-
-            // Calculate overlap
-            float overlap = std::min(max1, max2) - std::max(min1, min2);
-
-            // Track the smallest overlap and corresponding axis
-            if (overlap < minOverlap)
-            {
-                minOverlap = overlap;
-                minAxis = axisProj;
-            }
-
-            if (!(max2 >= min1 && max1 >= min2))
-                return result;
-        }
+    glm::vec2 limit = segment.convex1 ? ChainEdgeNormal(segment.worldGhost1, segment.worldPoint1)
+                                      : segment.normal;
+    return CrossProduct(limit, normal) >= -tolerance &&
+           glm::dot(normal, segment.normal + limit) > 0.0f;
+}
+
+// Separating axis test of a one sided segment against a polygon. Every axis can separate them, but
+// the reference edge is only picked from the polygon edges whose normals are admissible. Fills in
+// everything in the manifold apart from the colliders, the normal points from the segment
+static void CollideSegmentPolygon(Manifold& result, const ColSegment& segment,
+                                  const PolygonSoA& poly)
+{
+    result.colliding = false;
+    result.pointCount = 0;
+
+    glm::vec2 v1 = segment.worldPoint1;
+    glm::vec2 v2 = segment.worldPoint2;
+    glm::vec2 normal = segment.normal;
+
+    // Polygons with their center behind the segment pass through it
+    glm::vec2 center = glm::vec2(0.0f);
+    for (int i = 0; i < poly.count; ++i)
+    {
+        center += glm::vec2(poly.x[i], poly.y[i]);
     }
+    center /= (float)poly.count;
 
-    result.colliding = true;
-    result.objectA = &aabb;
-    result.objectB = &poly;
-    result.penetrationDepth = minOverlap;
+    if (glm::dot(normal, center - v1) < 0.0f)
+        return;
 
-    // Contact point detection here
-    std::vector<glm::vec2> intersections;
+    float segmentSeparation = FLT_MAX;
+    for (int i = 0; i < poly.count; ++i)
+    {
+        segmentSeparation =
+            MinFloat(segmentSeparation, glm::dot(normal, glm::vec2(poly.x[i], poly.y[i]) - v1));
+    }
 
-    size_t col1Size = col1->worldPoints.size();
-    size_t col2Size = col2->worldPoints.size();
+    if (segmentSeparation > 0.0f)
+        return;
 
-    for (size_t i = 0; i < col1Size; ++i)
+    int   polyEdge = -1;
+    float polySeparation = -FLT_MAX;
+    for (int i = 0; i < poly.count; ++i)
     {
-        glm::vec2 p0 = col1->worldPoints[i];
-        glm::vec2 p1 = col1->worldPoints[(i + 1) % col1Size];
+        glm::vec2 edgeNormal = glm::vec2(poly.normalX[i], poly.normalY[i]);
+        glm::vec2 vertex = glm::vec2(poly.x[i], poly.y[i]);
+
+        float separation =
+            MinFloat(glm::dot(edgeNormal, v1 - vertex), glm::dot(edgeNormal, v2 - vertex));
+        if (separation > 0.0f)
+            return;
 
-        for (size_t j = 0; j < col2Size; ++j)
+        if (separation > polySeparation && IsAdmissibleNormal(segment, -edgeNormal))
         {
-            glm::vec2 q0 = col2->worldPoints[j];
-            glm::vec2 q1 = col2->worldPoints[(j + 1) % col2Size];
-
-            auto intersection = GetLineIntersection(p0, p1, q0, q1);
-            if (intersection)
-            {
-                intersections.push_back(*intersection);
-            }
+            polySeparation = separation;
+            polyEdge = i;
         }
     }
 
-    if (intersections.size() == 2)
+    ClipVertex incidentPoints[2];
+
+    // The segment is preferred for the same reason polygon A is in CollidePolygons
+    const float tolerance = 0.1f * SM_LINEAR_SLOP;
+    if (polyEdge == -1 || polySeparation <= segmentSeparation + tolerance)
     {
-        result.contactPoint = (intersections[0] + intersections[1]) * 0.5f;
+        int incidentEdge = FindIncidentEdge(incidentPoints, poly, normal, 0, false);
+
+        if (ClipIncidentEdge(result, incidentPoints, v1, v2, normal, 0, incidentEdge, false) == 0)
+            return;
+
+        FinishManifold(result, normal, -segmentSeparation);
+        return;
     }
-    else
+
+    glm::vec2 referenceNormal = glm::vec2(poly.normalX[polyEdge], poly.normalY[polyEdge]);
+    int       referenceNext = (polyEdge + 1) % poly.count;
+    glm::vec2 v11 = glm::vec2(poly.x[polyEdge], poly.y[polyEdge]);
+    glm::vec2 v12 = glm::vec2(poly.x[referenceNext], poly.y[referenceNext]);
+
+    incidentPoints[0].point = v1;
+    incidentPoints[0].id = SM_MAKE_FEATURE_ID(polyEdge, 0, 0, true);
+    incidentPoints[1].point = v2;
+    incidentPoints[1].id = SM_MAKE_FEATURE_ID(polyEdge, 1, 0, true);
+
+    if (ClipIncidentEdge(result, incidentPoints, v11, v12, referenceNormal, polyEdge, 0, true) == 0)
+        return;
+
+    FinishManifold(result, -referenceNormal, -polySeparation);
+}
+
+Manifold TestColSegmentPolygon(Collider& segment, Collider& poly)
+{
+    Manifold result = {};
+    result.colliding = false;
+
+    CollideSegmentPolygon(result, segment.segment, poly.polygon.world);
+
+    if (result.colliding)
     {
-        result.contactPoint = intersections[0];
+        result.objectA = &segment;
+        result.objectB = &poly;
     }
 
-    // Ensure normal points from A to B
-    result.collisionNormal = minAxis;
-    if (glm::dot(result.collisionNormal, poly.polygon.center - a.center) < 0)
+    return result;
+}
+
+Manifold TestColSegmentAABB(Collider& segment, Collider& aabb)
+{
+    Manifold result = {};
+    result.colliding = false;
+
+    PolygonSoA box;
+    ComputeAABBPolygon(aabb, box);
+
+    CollideSegmentPolygon(result, segment.segment, box);
+
+    if (result.colliding)
     {
-        result.collisionNormal = -result.collisionNormal;
+        result.objectA = &segment;
+        result.objectB = &aabb;
     }
 
     return result;
 }
 
-Manifold TestColCirclePolygon(const Collider& circle, const Collider& poly)
+Manifold TestColSegmentCircle(Collider& segment, Collider& circle)
 {
-    // FIXME
-    Manifold result;
+    Manifold result = {};
     result.colliding = false;
 
+    const ColSegment& data = segment.segment;
+    glm::vec2         center = glm::vec2(circle.body->transform->position);
+    float             radius = circle.circle.radius;
+
+    // Circles with their center behind the segment pass through it
+    float distance = glm::dot(data.normal, center - data.worldPoint1);
+    if (distance < 0.0f || distance > radius)
+        return result;
+
+    glm::vec2 edge = data.worldPoint2 - data.worldPoint1;
+    float     along = glm::dot(center - data.worldPoint1, edge);
+
+    glm::vec2 closest;
+    glm::vec2 normal;
+
+    if (along > glm::dot(edge, edge))
+    {
+        // The next segment owns point2, whether the circle is over it or around the corner
+        return result;
+    }
+    else if (along < 0.0f)
+    {
+        // Around point1, the previous segment takes it if the circle is over that one
+        if (glm::dot(center - data.worldPoint1, data.worldPoint1 - data.worldGhost1) < 0.0f)
+            return result;
+
+        glm::vec2 offset = center - data.worldPoint1;
+        float     length = glm::length(offset);
+        if (length > radius || length < FLT_EPSILON)
+            return result;
+
+        closest = data.worldPoint1;
+        normal = offset / length;
+        distance = length;
+    }
+    else
+    {
+        closest = data.worldPoint1 + (along / glm::dot(edge, edge)) * edge;
+        normal = data.normal;
+    }
+
+    ContactPoint& contact = result.points[result.pointCount++];
+    contact.separation = distance - radius;
+    contact.point = closest + 0.5f * contact.separation * normal;
+    contact.id = 0;
+
+    FinishManifold(result, normal, radius - distance);
+    result.objectA = &segment;
+    result.objectB = &circle;
+
     return result;
 }
 
+Manifold TestCollision(Collider& a, Collider& b)
+{
+    Manifold data = {};
+    data.colliding = false;
+
+    if (a.type == ColliderType::sm2d_AABB && b.type == ColliderType::sm2d_AABB)
+    {
+        data = TestColAABBAABB(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Polygon && b.type == ColliderType::sm2d_Polygon)
+    {
+        data = TestColPolygonPolygon(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Polygon && b.type == ColliderType::sm2d_AABB)
+    {
+        data = TestColAABBPolygon(b, a);
+    }
+    else if (a.type == ColliderType::sm2d_AABB && b.type == ColliderType::sm2d_Polygon)
+    {
+        data = TestColAABBPolygon(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Polygon && b.type == ColliderType::sm2d_Circle)
+    {
+        data = TestColCirclePolygon(b, a);
+    }
+    else if (a.type == ColliderType::sm2d_Circle && b.type == ColliderType::sm2d_Polygon)
+    {
+        data = TestColCirclePolygon(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Circle && b.type == ColliderType::sm2d_Circle)
+    {
+        data = TestColCircleCircle(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Circle && b.type == ColliderType::sm2d_AABB)
+    {
+        data = TestColAABBCircle(b, a);
+    }
+    else if (a.type == ColliderType::sm2d_AABB && b.type == ColliderType::sm2d_Circle)
+    {
+        data = TestColAABBCircle(a, b);
+    }
+
+    else if (a.type == ColliderType::sm2d_Segment && b.type == ColliderType::sm2d_Polygon)
+    {
+        data = TestColSegmentPolygon(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Polygon && b.type == ColliderType::sm2d_Segment)
+    {
+        data = TestColSegmentPolygon(b, a);
+    }
+    else if (a.type == ColliderType::sm2d_Segment && b.type == ColliderType::sm2d_AABB)
+    {
+        data = TestColSegmentAABB(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_AABB && b.type == ColliderType::sm2d_Segment)
+    {
+        data = TestColSegmentAABB(b, a);
+    }
+    else if (a.type == ColliderType::sm2d_Segment && b.type == ColliderType::sm2d_Circle)
+    {
+        data = TestColSegmentCircle(a, b);
+    }
+    else if (a.type == ColliderType::sm2d_Circle && b.type == ColliderType::sm2d_Segment)
+    {
+        data = TestColSegmentCircle(b, a);
+    }
+
+    // The tests that don't clip only find a single point
+    if (data.colliding && data.pointCount == 0)
+    {
+        data.points[0].point = data.contactPoint;
+        data.points[0].separation = -data.penetrationDepth;
+        data.points[0].id = 0;
+        data.pointCount = 1;
+    }
+
+    return data;
+}
+
 } // namespace sm2d
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sm2d/types.h>
+#include <sm2d/sat.h>
 
 namespace sm2d
 {
@@ -12,21 +13,92 @@ struct ColAABB
 
 struct ColPolygon
 {
-    std::vector<glm::vec2> points;      // Points in object space
-    std::vector<glm::vec2> worldPoints; // Points in world space, get recomputed every frame
-    glm::vec2              center;      // Geometric center
+    std::vector<glm::vec2> points;      // Points in object space, fixed once the collider exists
+    std::vector<glm::vec2> worldPoints; // Points in world space, recomputed when the body moves
+    glm::vec2              center;      // Geometric center in world space
+    PolygonSoA             world;       // worldPoints and their edge normals for the SAT kernels
+
+    // Computed once when the collider is created
+    PolygonSoA local;       // points and their edge normals, the world data is rotated from these
+    glm::vec2  localCenter; // Geometric center in object space
+    float      area;
+    float      inertia; // Moment of inertia about the body's origin for a density of one
 };
 
+// Returns the polygon if it has 3 to SM_MAX_POLYGON_VERTICES points, the contact code keeps
+// polygons in arrays of that size. Otherwise it prints an error and returns one that fits, with
+// only the first points of a bigger polygon or a tiny square for a smaller one
+ColPolygon CheckPolygon(const ColPolygon& poly);
+
+// Fills in the object space data of a polygon and sizes its world points, colliders do this when
+// they're created
+void InitPolygon(ColPolygon& poly);
+
 struct ColCircle
 {
     float radius;
 };
 
+struct Collider;
+
+// One edge of a chain, only shapes in front of it on the side its normal points to collide with
+// it. The ghost points are the ends of the neighbouring edges, contacts don't get normals that
+// would point into a neighbour so shapes slide over the seams instead of catching on them
+struct ColSegment
+{
+    glm::vec2 ghost1; // Object space, the point before point1 in the chain
+    glm::vec2 point1;
+    glm::vec2 point2;
+    glm::vec2 ghost2; // Object space, the point after point2 in the chain
+
+    // World space, recomputed when the body moves
+    glm::vec2 worldGhost1;
+    glm::vec2 worldPoint1;
+    glm::vec2 worldPoint2;
+    glm::vec2 worldGhost2;
+    glm::vec2 normal; // Points out of the solid side
+
+    // Computed once when the collider is created
+    glm::vec2 localNormal;
+    bool      convex1; // The chain turns away from the free side at point1
+    bool      convex2; // The chain turns away from the free side at point2
+
+    Collider* chain = nullptr; // Chain the segment was made from
+};
+
+// Fills in the object space data of a segment, colliders do this when they're created
+void InitSegment(ColSegment& segment);
+
+// A line of one sided segments for level geometry. Walking from point to point the solid side is
+// on the left, so a loop around solid ground goes counter-clockwise and its normals point out of
+// it. Adding a chain to a world makes a segment collider for every edge, the world owns those and
+// they're what the trees, contacts and queries see. The first and last points of an open chain
+// are only ghosts, so an open chain needs at least four points and a loop three
+struct ColChain
+{
+    std::vector<glm::vec2> points; // Object space
+    bool                   loop = false;
+
+    std::vector<Collider*> segments; // Filled in when the chain is added to a world
+};
+
+// Decides which colliders can touch. Two colliders collide if each one's category is in the
+// other's mask, unless they share a group index. A shared positive group always collides and a
+// shared negative group never does
+struct Filter
+{
+    uint32_t categoryBits = SM_DEFAULT_CATEGORY_BITS; // What this collider is
+    uint32_t maskBits = SM_ALL_CATEGORY_BITS;         // What it collides with
+    int      groupIndex = 0;                          // Zero for no group
+};
+
 enum ColliderType
 {
     sm2d_AABB,
     sm2d_Circle,
-    sm2d_Polygon
+    sm2d_Polygon,
+    sm2d_Segment,
+    sm2d_Chain
 };
 
 struct Collider
@@ -37,9 +109,18 @@ struct Collider
         ColAABB    aabb;
         ColCircle  circle;
         ColPolygon polygon;
+        ColSegment segment;
+        ColChain   chain;
     };
     Rigidbody* body;
     int        treeIndex = -1; // Index in the AABB tree
+    Filter     filter;         // Change it with SetFilter once the collider is in the tree
+    bool       sensor = false; // Only reports overlaps as sensor events, never gets a contact
+
+    // Body transform the world space data was last computed for, see SyncCollider
+    glm::vec2 syncedPosition = glm::vec2(0.0f);
+    float     syncedRotation = 0.0f;
+    bool      synced = false;
 
     Collider(ColliderType type, const ColAABB& aabb, Rigidbody* body)
        : type(type), aabb(aabb), body(body)
@@ -50,22 +131,42 @@ struct Collider
     {
     }
     Collider(ColliderType type, const ColPolygon& poly, Rigidbody* body)
-       : type(type), polygon(poly), body(body)
+       : type(type), polygon(CheckPolygon(poly)), body(body)
+    {
+        InitPolygon(polygon);
+    }
+    Collider(ColliderType type, const ColSegment& segment, Rigidbody* body)
+       : type(type), segment(segment), body(body)
+    {
+        InitSegment(this->segment);
+    }
+    Collider(ColliderType type, const ColChain& chain, Rigidbody* body)
+       : type(type), chain(chain), body(body)
     {
     }
 
     ~Collider() {} // This is just here so the compiler doesn't yell at me
 };
 
+struct ContactPoint
+{
+    glm::vec2 point;      // World space position, halfway between the two surfaces
+    float     separation; // Negative when the shapes overlap
+    uint32_t  id;         // Which features made this point, stays the same between frames
+};
+
 struct Manifold 
 {
     bool      colliding;        // Are they colliding?
     glm::vec2 collisionNormal;  // Direction of the collision used for impulse calculation
     float     penetrationDepth; // How far they're inside each other
-    glm::vec2 contactPoint;     // Point of contact
+    glm::vec2 contactPoint;     // Point of contact, the average of the contact points
     Collider* objectA;          // Pointer to the first object involved in the collision
     Collider* objectB;          // Pointer to the second object involved in the collision
 
+    ContactPoint points[SM_MAX_MANIFOLD_POINTS]; // Contact points in the manifold
+    int          pointCount = 0;                 // How many of the contact points are used
+
     operator bool() const { return colliding; }
 };
 
@@ -79,4 +180,13 @@ Manifold TestColAABBCircle(const Collider& aabb, const Collider& circle);
 Manifold TestColAABBPolygon(Collider& aabb, Collider& poly);
 Manifold TestColCirclePolygon(const Collider& circle, const Collider& poly);
 
+// A segment against a shape on its front side, the normal points from the segment to the shape.
+// Segments never collide with each other
+Manifold TestColSegmentPolygon(Collider& segment, Collider& poly);
+Manifold TestColSegmentAABB(Collider& segment, Collider& aabb);
+Manifold TestColSegmentCircle(Collider& segment, Collider& circle);
+
+// Runs the intersection test that matches the types of the two colliders
+Manifold TestCollision(Collider& a, Collider& b);
+
 } // namespace sm2d
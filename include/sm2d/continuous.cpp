@@ -0,0 +1,254 @@
+#include <sm2d/continuous.h>
+#include <sm2d/functions.h>
+#include <sm2d/queries.h>
+#include <sm2d/sat.h>
+#include <cfloat>
+#include <cmath>
+
+namespace sm2d
+{
+
+// A collider's world space shape moved by an offset
+struct SweptShape
+{
+    bool       isCircle;
+    bool       isSegment; // The polygon is the segment's two points, with its normal both ways
+    glm::vec2  center;
+    float      radius;
+    PolygonSoA polygon;
+};
+
+static void MakeSweptShape(SweptShape& shape, const Collider& collider, const glm::vec2& offset)
+{
+    shape.isCircle = collider.type == ColliderType::sm2d_Circle;
+    shape.isSegment = collider.type == ColliderType::sm2d_Segment;
+
+    if (shape.isCircle)
+    {
+        shape.center = glm::vec2(collider.body->transform->position) + offset;
+        shape.radius = collider.circle.radius;
+        return;
+    }
+
+    if (collider.type == ColliderType::sm2d_AABB)
+    {
+        ComputeAABBPolygon(collider, shape.polygon);
+    }
+    else if (shape.isSegment)
+    {
+        const ColSegment& segment = collider.segment;
+        for (int i = 0; i < SM_MAX_POLYGON_VERTICES; ++i)
+        {
+            glm::vec2 point = i == 1 ? segment.worldPoint2 : segment.worldPoint1;
+            glm::vec2 normal = i == 1 ? -segment.normal : segment.normal;
+            shape.polygon.x[i] = point.x;
+            shape.polygon.y[i] = point.y;
+            shape.polygon.normalX[i] = normal.x;
+            shape.polygon.normalY[i] = normal.y;
+        }
+        shape.polygon.count = 2;
+    }
+    else
+    {
+        shape.polygon = collider.polygon.world;
+    }
+
+    for (int i = 0; i < SM_MAX_POLYGON_VERTICES; ++i)
+    {
+        shape.polygon.x[i] += offset.x;
+        shape.polygon.y[i] += offset.y;
+    }
+}
+
+// Largest separation of a circle along the edge normals of a polygon
+static float PolygonCircleSeparation(glm::vec2& normal, const PolygonSoA& poly,
+                                     const glm::vec2& center, float radius)
+{
+    float maxSeparation = -FLT_MAX;
+
+    for (int i = 0; i < poly.count; ++i)
+    {
+        float separation = poly.normalX[i] * (center.x - poly.x[i]) +
+                           poly.normalY[i] * (center.y - poly.y[i]) - radius;
+        if (separation > maxSeparation)
+        {
+            maxSeparation = separation;
+            normal = glm::vec2(poly.normalX[i], poly.normalY[i]);
+        }
+    }
+
+    return maxSeparation;
+}
+
+// Separation of two shapes along the best separating axis, it's never more than the distance
+// between them so advancing by it can't skip past a hit. normal points from other to moving
+static float ComputeSeparation(glm::vec2& normal, const SweptShape& moving,
+                               const SweptShape& other)
+{
+    if (moving.isCircle && other.isCircle)
+    {
+        glm::vec2 delta = moving.center - other.center;
+        float     distance = glm::length(delta);
+        normal = distance > FLT_EPSILON ? delta / distance : glm::vec2(0.0f, 1.0f);
+        return distance - moving.radius - other.radius;
+    }
+
+    if (moving.isCircle && other.isSegment)
+    {
+        glm::vec2 v1 = glm::vec2(other.polygon.x[0], other.polygon.y[0]);
+        glm::vec2 v2 = glm::vec2(other.polygon.x[1], other.polygon.y[1]);
+        glm::vec2 delta = moving.center - ClosestPointOnLineSegment(moving.center, v1, v2);
+        float     distance = glm::length(delta);
+
+        // The segment's normal is the first one of its polygon
+        glm::vec2 segmentNormal = glm::vec2(other.polygon.normalX[0], other.polygon.normalY[0]);
+        normal = distance > FLT_EPSILON ? delta / distance : segmentNormal;
+        return distance - moving.radius;
+    }
+
+    if (moving.isCircle)
+    {
+        return PolygonCircleSeparation(normal, other.polygon, moving.center, moving.radius);
+    }
+
+    if (other.isCircle)
+    {
+        float separation =
+            PolygonCircleSeparation(normal, moving.polygon, other.center, other.radius);
+        normal = -normal;
+        return separation;
+    }
+
+    int   edgeOther = 0;
+    int   edgeMoving = 0;
+    float separationOther = FindMaxSeparation(edgeOther, other.polygon, moving.polygon);
+    float separationMoving = FindMaxSeparation(edgeMoving, moving.polygon, other.polygon);
+
+    if (separationOther >= separationMoving)
+    {
+        normal = glm::vec2(other.polygon.normalX[edgeOther], other.polygon.normalY[edgeOther]);
+        return separationOther;
+    }
+
+    normal = -glm::vec2(moving.polygon.normalX[edgeMoving], moving.polygon.normalY[edgeMoving]);
+    return separationMoving;
+}
+
+bool ComputeTimeOfImpact(float& toi, glm::vec2& normal, const Collider& moving,
+                         const glm::vec2& translation, const Collider& other)
+{
+    float distance = glm::length(translation);
+    if (distance < FLT_EPSILON)
+        return false;
+
+    // Segments are one sided, a collider that starts behind one passes through it
+    if (other.type == ColliderType::sm2d_Segment)
+    {
+        glm::vec2 start = glm::vec2(moving.body->transform->position) - translation;
+        if (glm::dot(other.segment.normal, start - other.segment.worldPoint1) < 0.0f)
+            return false;
+    }
+
+    // Aim to stop a little short of touching so the contact solver still sees a gap to close
+    const float target = SM_LINEAR_SLOP;
+    const float tolerance = 0.25f * SM_LINEAR_SLOP;
+
+    SweptShape movingShape;
+    SweptShape otherShape;
+    MakeSweptShape(otherShape, other, glm::vec2(0.0f));
+
+    float t = 0.0f;
+    for (int iteration = 0; iteration < SM_MAX_TOI_ITERATIONS; ++iteration)
+    {
+        MakeSweptShape(movingShape, moving, (t - 1.0f) * translation);
+        float separation = ComputeSeparation(normal, movingShape, otherShape);
+
+        // Colliders that are already touching at the start are left to the contact solver,
+        // otherwise a bullet sliding along the ground would be stopped every step
+        if (iteration == 0 && separation < target)
+            return false;
+
+        if (separation < target + tolerance)
+        {
+            toi = t;
+            return true;
+        }
+
+        // Nothing on the moving collider travels further than the whole translation
+        t += (separation - target) / distance;
+        if (t >= 1.0f)
+            return false;
+    }
+
+    // Out of iterations, stopping early is better than letting the body tunnel
+    toi = t;
+    return true;
+}
+
+void SolveBullet(World& world, Collider& collider)
+{
+    Rigidbody* body = collider.body;
+
+    // Sensors pass through everything
+    if (collider.sensor)
+        return;
+
+    glm::vec2 start = body->previousPosition;
+    glm::vec2 translation = glm::vec2(body->transform->position) - start;
+    if (glm::dot(translation, translation) < SM_LINEAR_SLOP * SM_LINEAR_SLOP)
+        return;
+
+    // The leaf holds the swept box, so this finds every static collider the motion could touch
+    std::vector<Collider*>& candidates = world.buffers.bulletCandidates;
+    candidates.clear();
+    // A positive group can collide with categories outside the mask, those are filtered below
+    uint32_t maskBits =
+        collider.filter.groupIndex > 0 ? SM_ALL_CATEGORY_BITS : collider.filter.maskBits;
+    OverlapAABB(world.staticTree, world.dynamicTree.nodes[collider.treeIndex].box, candidates,
+                maskBits);
+
+    float     minToi = 1.0f;
+    glm::vec2 hitNormal = glm::vec2(0.0f);
+    Collider* hitCollider = nullptr;
+
+    for (Collider* other : candidates)
+    {
+        if (other == &collider || other->body->type != BodyType::sm2d_Static || other->sensor ||
+            !ShouldCollide(collider.filter, other->filter))
+        {
+            continue;
+        }
+
+        float     toi;
+        glm::vec2 normal;
+        if (ComputeTimeOfImpact(toi, normal, collider, translation, *other) && toi < minToi)
+        {
+            minToi = toi;
+            hitNormal = normal;
+            hitCollider = other;
+        }
+    }
+
+    if (hitCollider == nullptr)
+        return;
+
+    glm::vec2 position = start + minToi * translation;
+    body->transform->position.x = position.x;
+    body->transform->position.y = position.y;
+
+    // Take out the velocity into the surface the same way a contact with it would
+    float normalSpeed = glm::dot(body->linearVelocity, hitNormal);
+    if (normalSpeed < 0.0f)
+    {
+        float e = std::min(body->restitution, hitCollider->body->restitution);
+        body->linearVelocity -= (1.0f + e) * normalSpeed * hitNormal;
+    }
+
+    CopyBodyToStorage(body);
+    SyncCollider(collider);
+
+    RemoveLeaf(world.dynamicTree, collider.treeIndex);
+    InsertLeaf(world.dynamicTree, &collider, ColliderToAABB(collider));
+}
+
+} // namespace sm2d
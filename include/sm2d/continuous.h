@@ -0,0 +1,24 @@
+#pragma once
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/world.h>
+
+#define SM_MAX_TOI_ITERATIONS (20) // Conservative advancement gives up and reports a hit after this
+
+namespace sm2d
+{
+
+// Finds when a collider moving by translation first touches another collider with conservative
+// advancement. The moving collider is taken at its current rotation with its body's position at
+// the end of the motion. Returns false if they don't touch before the end of the motion,
+// otherwise toi is the fraction of the motion and normal points from other towards moving
+bool ComputeTimeOfImpact(float& toi, glm::vec2& normal, const Collider& moving,
+                         const glm::vec2& translation, const Collider& other);
+
+// Sweeps a bullet collider from where its body started the step to where it is now against the
+// colliders in the world's static tree. If it hits one the body is moved back to the time of
+// impact, its velocity into the surface is removed and its leaf in the dynamic tree is updated
+void SolveBullet(World& world, Collider& collider);
+
+} // namespace sm2d
@@ -1,7 +1,9 @@
 #include <sm2d/functions.h>
+#include <sm2d/thread_pool.h>
 #include <cassert>
 #include <cmath>
 #include <algorithm>
+#include <functional>
 
 namespace sm2d
 {
@@ -69,15 +71,85 @@ glm::vec2 LocalToWorld(glm::vec2 point, const glm::vec2 pos, float cosine, float
 
 void UpdatePolygon(Collider& poly)
 {
-    float sine = sin(poly.body->transform->rotation.z);
-    float cosine = cos(poly.body->transform->rotation.z);
+    float rotation = poly.body->transform->rotation.z;
+    float sine = sin(rotation);
+    float cosine = cos(rotation);
 
     glm::vec2 pos = glm::vec2(poly.body->transform->position);
 
-    for (int i = 0; i < poly.polygon.points.size(); ++i)
+    // The cached object space normals only need rotating, they never get normalized again
+    const PolygonSoA& local = poly.polygon.local;
+    PolygonSoA&       world = poly.polygon.world;
+
+    for (int i = 0; i < SM_MAX_POLYGON_VERTICES; ++i)
+    {
+        world.x[i] = (cosine * local.x[i] - sine * local.y[i]) + pos.x;
+        world.y[i] = (sine * local.x[i] + cosine * local.y[i]) + pos.y;
+        world.normalX[i] = cosine * local.normalX[i] - sine * local.normalY[i];
+        world.normalY[i] = sine * local.normalX[i] + cosine * local.normalY[i];
+    }
+    world.count = local.count;
+
+    for (int i = 0; i < world.count; ++i)
     {
-        poly.polygon.worldPoints[i] = LocalToWorld(poly.polygon.points[i], pos, cosine, sine);
+        poly.polygon.worldPoints[i] = glm::vec2(world.x[i], world.y[i]);
     }
+
+    poly.polygon.center = LocalToWorld(poly.polygon.localCenter, pos, cosine, sine);
+
+    poly.syncedPosition = pos;
+    poly.syncedRotation = rotation;
+    poly.synced = true;
+}
+
+void UpdateSegment(Collider& segment)
+{
+    float rotation = segment.body->transform->rotation.z;
+    float sine = sin(rotation);
+    float cosine = cos(rotation);
+
+    glm::vec2   pos = glm::vec2(segment.body->transform->position);
+    ColSegment& data = segment.segment;
+
+    data.worldGhost1 = LocalToWorld(data.ghost1, pos, cosine, sine);
+    data.worldPoint1 = LocalToWorld(data.point1, pos, cosine, sine);
+    data.worldPoint2 = LocalToWorld(data.point2, pos, cosine, sine);
+    data.worldGhost2 = LocalToWorld(data.ghost2, pos, cosine, sine);
+    data.normal = glm::vec2(cosine * data.localNormal.x - sine * data.localNormal.y,
+                            sine * data.localNormal.x + cosine * data.localNormal.y);
+
+    segment.syncedPosition = pos;
+    segment.syncedRotation = rotation;
+    segment.synced = true;
+}
+
+bool SyncCollider(Collider& collider)
+{
+    glm::vec2 position = glm::vec2(collider.body->transform->position);
+    float     rotation = collider.body->transform->rotation.z;
+
+    if (collider.synced && position == collider.syncedPosition &&
+        rotation == collider.syncedRotation)
+    {
+        return false;
+    }
+
+    if (collider.type == ColliderType::sm2d_Polygon)
+    {
+        UpdatePolygon(collider);
+    }
+    else if (collider.type == ColliderType::sm2d_Segment)
+    {
+        UpdateSegment(collider);
+    }
+    else
+    {
+        collider.syncedPosition = position;
+        collider.syncedRotation = rotation;
+        collider.synced = true;
+    }
+
+    return true;
 }
 
 glm::vec2 ComputePolygonCenter(ColPolygon& poly)
@@ -114,7 +186,7 @@ glm::vec2 ComputePolygonCenter(ColPolygon& poly)
     return center;
 }
 
-void ComputeAABBPoints(const Collider& collider, std::vector<glm::vec2>& points)
+void ComputeAABBPoints(const Collider& collider, glm::vec2 points[4])
 {
     glm::vec2 topLeft = glm::vec2(collider.body->transform->position) +
                         glm::vec2(-collider.aabb.halfwidths.x, collider.aabb.halfwidths.y);
@@ -124,7 +196,30 @@ void ComputeAABBPoints(const Collider& collider, std::vector<glm::vec2>& points)
                             glm::vec2(collider.aabb.halfwidths.x, -collider.aabb.halfwidths.y);
     glm::vec2 bottomLeft = glm::vec2(collider.body->transform->position) +
                            glm::vec2(-collider.aabb.halfwidths.x, -collider.aabb.halfwidths.y);
-    points = {bottomLeft, topLeft, topRight, bottomRight};
+    points[0] = bottomLeft;
+    points[1] = topLeft;
+    points[2] = topRight;
+    points[3] = bottomRight;
+}
+
+void ComputeAABBPolygon(const Collider& collider, PolygonSoA& box)
+{
+    glm::vec2 points[4];
+    ComputeAABBPoints(collider, points);
+
+    // The box normals are known up front, so this skips the normalizing in BuildPolygonSoA
+    const float normalsX[4] = {-1.0f, 0.0f, 1.0f, 0.0f};
+    const float normalsY[4] = {0.0f, 1.0f, 0.0f, -1.0f};
+
+    for (int i = 0; i < SM_MAX_POLYGON_VERTICES; ++i)
+    {
+        int vertex = i < 4 ? i : 0;
+        box.x[i] = points[vertex].x;
+        box.y[i] = points[vertex].y;
+        box.normalX[i] = normalsX[vertex];
+        box.normalY[i] = normalsY[vertex];
+    }
+    box.count = 4;
 }
 
 glm::vec2 VectorScalarCross(const glm::vec2& v, float s)
@@ -343,6 +438,43 @@ int FindBestSibling(Tree& tree, const AABB& box)
     return bestSibling;
 }
 
+// A positive group collides no matter the masks, so those leaves can't be pruned by their bits
+static void SetLeafFilterBits(Node& node)
+{
+    const Filter& filter = node.collider->filter;
+    bool          alwaysCollides = filter.groupIndex > 0;
+
+    node.categoryBits = alwaysCollides ? SM_ALL_CATEGORY_BITS : filter.categoryBits;
+    node.maskBits = alwaysCollides ? SM_ALL_CATEGORY_BITS : filter.maskBits;
+}
+
+// Takes a node off the free list, or adds one to the end if there aren't any
+static int AllocateNode(Tree& tree)
+{
+    if (tree.freeList == -1)
+    {
+        tree.nodes.push_back(Node{});
+        return (int)tree.nodes.size() - 1;
+    }
+
+    int index = tree.freeList;
+    tree.freeList = tree.nodes[index].parentIndex;
+    return index;
+}
+
+// Puts a node on the free list, linked through its parent index. Free nodes aren't leaves and
+// have no collider, so loops over the nodes skip them
+static void FreeNode(Tree& tree, int index)
+{
+    Node& node = tree.nodes[index];
+    node = Node{};
+    node.index = -1;
+    node.parentIndex = tree.freeList;
+    node.child1 = -1;
+    node.child2 = -1;
+    tree.freeList = index;
+}
+
 void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
 {
     // If the tree is empty, create the first node as the root
@@ -354,6 +486,7 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
         newNode.index = 0;
         newNode.collider->treeIndex = 0;
         newNode.leaf = true;
+        SetLeafFilterBits(newNode);
         newNode.parentIndex = -1;
         newNode.child1 = -1;
         newNode.child2 = -1;
@@ -363,19 +496,18 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
         return;
     }
 
-    // Stage 0: Push leaf to tree
+    // Stage 0: Push leaf to tree, reusing a node a removed leaf left behind if there is one
 
-    Node newNode;
+    int   leaf = AllocateNode(tree);
+    Node& newNode = tree.nodes[leaf];
     newNode.collider = body;
     newNode.box = box;
-    newNode.index = (int)tree.nodes.size();
-    newNode.collider->treeIndex = newNode.index;
+    newNode.index = leaf;
+    newNode.collider->treeIndex = leaf;
     newNode.leaf = true;
+    SetLeafFilterBits(newNode);
     newNode.child1 = -1;
     newNode.child2 = -1;
-    tree.nodes.push_back(newNode);
-
-    int leaf = newNode.index;
 
     // Stage 1: Find best sibling for new leaf
 
@@ -385,15 +517,13 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
 
     int oldParent = tree.nodes[sibling].parentIndex;
 
-    Node newParent;
+    int   newParentIndex = AllocateNode(tree);
+    Node& newParent = tree.nodes[newParentIndex];
     newParent.parentIndex = oldParent;
     newParent.box = AABBUnion(box, tree.nodes[sibling].box);
     newParent.leaf = false;
     newParent.collider = nullptr;
-    newParent.index = (int)tree.nodes.size();
-
-    tree.nodes.push_back(newParent);
-    int newParentIndex = newParent.index;
+    newParent.index = newParentIndex;
 
     if (oldParent != -1)
     {
@@ -428,10 +558,14 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
     {
         Node& node = tree.nodes[currentNode];
 
-        // Recompute the bounding box of the current node
+        // Recompute the bounding box and filter bits of the current node
         if (!node.leaf)
         {
-            node.box = AABBUnion(tree.nodes[node.child1].box, tree.nodes[node.child2].box);
+            const Node& child1 = tree.nodes[node.child1];
+            const Node& child2 = tree.nodes[node.child2];
+            node.box = AABBUnion(child1.box, child2.box);
+            node.categoryBits = child1.categoryBits | child2.categoryBits;
+            node.maskBits = child1.maskBits | child2.maskBits;
         }
 
         // Move up to the parent node
@@ -442,7 +576,7 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box)
 void RemoveLeaf(Tree& tree, int leafIndex)
 {
     // If the tree is empty or the leaf index is invalid, do nothing
-    if (tree.nodes.empty() || leafIndex < 0 || leafIndex >= tree.nodes.size())
+    if (tree.nodes.empty() || leafIndex < 0 || leafIndex >= (int)tree.nodes.size())
         return;
 
     // If this is the root and it's a leaf, clear the entire tree
@@ -450,6 +584,7 @@ void RemoveLeaf(Tree& tree, int leafIndex)
     {
         tree.nodes.clear();
         tree.rootIndex = -1;
+        tree.freeList = -1;
         return;
     }
 
@@ -489,8 +624,8 @@ void RemoveLeaf(Tree& tree, int leafIndex)
         tree.nodes[siblingIndex].parentIndex = -1;
     }
 
-    tree.nodes[leafIndex] = Node(-1);
-    tree.nodes[parentIndex] = Node(-1);
+    FreeNode(tree, leafIndex);
+    FreeNode(tree, parentIndex);
 
     // Refit the tree from the grandparent upwards
     int currentNode = grandParentIndex;
@@ -498,10 +633,14 @@ void RemoveLeaf(Tree& tree, int leafIndex)
     {
         Node& node = tree.nodes[currentNode];
 
-        // Recompute the bounding box of the current node
+        // Recompute the bounding box and filter bits of the current node
         if (!node.leaf)
         {
-            node.box = AABBUnion(tree.nodes[node.child1].box, tree.nodes[node.child2].box);
+            const Node& child1 = tree.nodes[node.child1];
+            const Node& child2 = tree.nodes[node.child2];
+            node.box = AABBUnion(child1.box, child2.box);
+            node.categoryBits = child1.categoryBits | child2.categoryBits;
+            node.maskBits = child1.maskBits | child2.maskBits;
         }
 
         // Move up to the parent node
@@ -509,53 +648,173 @@ void RemoveLeaf(Tree& tree, int leafIndex)
     }
 }
 
-void RemoveDeletedLeaves(Tree& tree)
+// A collider waiting to be placed by BuildTree
+struct BuildLeaf
 {
-    // First pass: create a mapping of old indices to new indices
-    std::unordered_map<int, int> indexMap;
-    std::vector<Node>            newNodes;
+    Collider* collider;
+    AABB      box;
+    glm::vec2 center;
+};
+
+// Builds the subtree over leaves [begin, end) and returns the index of its root
+static int BuildSubtree(Tree& tree, std::vector<BuildLeaf>& leaves, int begin, int end,
+                        int parentIndex)
+{
+    int index = (int)tree.nodes.size();
+    tree.nodes.push_back(Node{});
+    tree.nodes[index].index = index;
+    tree.nodes[index].parentIndex = parentIndex;
 
-    for (int oldIndex = 0; oldIndex < tree.nodes.size(); ++oldIndex)
+    if (end - begin == 1)
     {
-        if (tree.nodes[oldIndex].index != -1)
-        {
-            indexMap[oldIndex] = (int)newNodes.size();
-            newNodes.push_back(tree.nodes[oldIndex]);
-            newNodes.back().index = (int)newNodes.size() - 1;
-            if (newNodes.back().collider)
-                newNodes.back().collider->treeIndex = (int)newNodes.size() - 1;
-        }
+        Node& node = tree.nodes[index];
+        node.collider = leaves[begin].collider;
+        node.box = leaves[begin].box;
+        node.leaf = true;
+        node.child1 = -1;
+        node.child2 = -1;
+        node.collider->treeIndex = index;
+        SetLeafFilterBits(node);
+        return index;
     }
 
-    // Second pass: update parent and child indices
-    for (auto& node : newNodes)
+    // Split along the axis the centers are spread out the most on
+    glm::vec2 centerMin = leaves[begin].center;
+    glm::vec2 centerMax = leaves[begin].center;
+    for (int i = begin + 1; i < end; ++i)
     {
-        if (node.parentIndex != -1)
+        centerMin = glm::min(centerMin, leaves[i].center);
+        centerMax = glm::max(centerMax, leaves[i].center);
+    }
+
+    int   axis = centerMax.x - centerMin.x >= centerMax.y - centerMin.y ? 0 : 1;
+    float extent = centerMax[axis] - centerMin[axis];
+    int   middle = begin + (end - begin) / 2; // Used as is when every center is in one spot
+
+    if (extent > 0.0f)
+    {
+        // Bin the leaves by center and pick the split between bins with the lowest cost, the
+        // perimeter of each side weighted by how many leaves it holds
+        int  binCounts[SM_TREE_BUILD_BINS] = {};
+        AABB binBoxes[SM_TREE_BUILD_BINS];
+        auto BinOf = [&](const BuildLeaf& leaf)
         {
-            node.parentIndex = indexMap[node.parentIndex];
+            int bin = (int)((leaf.center[axis] - centerMin[axis]) / extent * SM_TREE_BUILD_BINS);
+            return std::min(bin, SM_TREE_BUILD_BINS - 1);
+        };
+
+        for (int i = begin; i < end; ++i)
+        {
+            int bin = BinOf(leaves[i]);
+            binBoxes[bin] = binCounts[bin] == 0 ? leaves[i].box
+                                                : AABBUnion(binBoxes[bin], leaves[i].box);
+            ++binCounts[bin];
+        }
+
+        // Costs of everything right of each split, swept from the right
+        float rightCosts[SM_TREE_BUILD_BINS];
+        int   rightCount = 0;
+        AABB  rightBox;
+        for (int bin = SM_TREE_BUILD_BINS - 1; bin > 0; --bin)
+        {
+            if (binCounts[bin] > 0)
+            {
+                rightBox = rightCount == 0 ? binBoxes[bin] : AABBUnion(rightBox, binBoxes[bin]);
+                rightCount += binCounts[bin];
+            }
+            rightCosts[bin] = rightCount == 0 ? 0.0f : AABBPerimeter(rightBox) * rightCount;
         }
 
-        if (node.child1 != -1)
+        float bestCost = FLT_MAX;
+        int   bestSplit = -1;
+        int   leftCount = 0;
+        AABB  leftBox;
+        for (int bin = 0; bin < SM_TREE_BUILD_BINS - 1; ++bin)
         {
-            node.child1 = indexMap[node.child1];
+            if (binCounts[bin] > 0)
+            {
+                leftBox = leftCount == 0 ? binBoxes[bin] : AABBUnion(leftBox, binBoxes[bin]);
+                leftCount += binCounts[bin];
+            }
+
+            // Splits with nothing on one side don't split anything
+            if (leftCount == 0 || leftCount == end - begin)
+                continue;
+
+            float cost = AABBPerimeter(leftBox) * leftCount + rightCosts[bin + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = bin;
+            }
         }
 
-        if (node.child2 != -1)
+        if (bestSplit != -1)
         {
-            node.child2 = indexMap[node.child2];
+            auto split = std::partition(leaves.begin() + begin, leaves.begin() + end,
+                                        [&](const BuildLeaf& leaf)
+                                        { return BinOf(leaf) <= bestSplit; });
+            middle = (int)(split - leaves.begin());
         }
     }
 
-    // Update root index
-    tree.rootIndex = indexMap[tree.rootIndex];
+    int child1 = BuildSubtree(tree, leaves, begin, middle, index);
+    int child2 = BuildSubtree(tree, leaves, middle, end, index);
+
+    Node& node = tree.nodes[index];
+    node.collider = nullptr;
+    node.leaf = false;
+    node.child1 = child1;
+    node.child2 = child2;
+    node.box = AABBUnion(tree.nodes[child1].box, tree.nodes[child2].box);
+    node.categoryBits = tree.nodes[child1].categoryBits | tree.nodes[child2].categoryBits;
+    node.maskBits = tree.nodes[child1].maskBits | tree.nodes[child2].maskBits;
+    return index;
+}
+
+void BuildTree(Tree& tree, const std::vector<Collider*>& colliders)
+{
+    tree.nodes.clear();
+    tree.rootIndex = -1;
+    tree.freeList = -1;
 
-    // Replace old nodes vector
-    tree.nodes = std::move(newNodes);
+    if (colliders.empty())
+        return;
+
+    std::vector<BuildLeaf> leaves;
+    leaves.reserve(colliders.size());
+    for (Collider* collider : colliders)
+    {
+        SyncCollider(*collider);
+        AABB box = ColliderToAABB(*collider);
+        leaves.push_back({collider, box, AABBCenter(box)});
+    }
+
+    // A binary tree over n leaves has n - 1 internal nodes
+    tree.nodes.reserve(2 * leaves.size() - 1);
+    tree.rootIndex = BuildSubtree(tree, leaves, 0, (int)leaves.size(), -1);
 }
 
-void GetCollisionsInTree(const Tree& tree, std::vector<Manifold>& collisionResults)
+void RebuildTree(Tree& tree)
 {
-    // Recursive lambda function to traverse and check collisions
+    std::vector<Collider*> colliders;
+    for (const Node& node : tree.nodes)
+    {
+        if (node.leaf && node.collider != nullptr)
+        {
+            colliders.push_back(node.collider);
+        }
+    }
+
+    BuildTree(tree, colliders);
+}
+
+void GetPairsInTree(const Tree& tree, std::vector<Pair>& pairs)
+{
+    if (tree.nodes.empty())
+        return;
+
+    // Recursive lambda function to traverse the tree and collect the overlapping leaves
     std::function<void(int, int)> CheckCollisions = [&](int node1Index, int node2Index)
     {
         // Invalid node check
@@ -565,112 +824,525 @@ void GetCollisionsInTree(const Tree& tree, std::vector<Manifold>& collisionResul
         const Node& node1 = tree.nodes[node1Index];
         const Node& node2 = tree.nodes[node2Index];
 
-        // First, check if the bounding boxes of the nodes overlap
+        // Nothing in one subtree is in any mask of the other, so no pair between them collides.
+        // It's cheaper than the box test, so it goes first
+        if ((node1.categoryBits & node2.maskBits) == 0 ||
+            (node2.categoryBits & node1.maskBits) == 0)
+        {
+            return;
+        }
+
+        // Check if the bounding boxes of the nodes overlap
         if (!AABBTest(node1.box, node2.box))
             return;
 
-        // If both are leaf nodes, perform collision test
-        if (node1.leaf && node2.leaf)
+        // If both are leaf nodes, they're a pair
+        if (node1.leaf && node2.leaf && node1Index != node2Index)
         {
-            Manifold data;
-            if (node1.collider->type == ColliderType::sm2d_AABB &&
-                node2.collider->type == ColliderType::sm2d_AABB)
-            {
-                data = TestColAABBAABB(*node1.collider, *node2.collider);
-            }
-            else if (node1.collider->type == ColliderType::sm2d_Polygon &&
-                     node2.collider->type == ColliderType::sm2d_Polygon)
+            // Pairs where neither body can move are skipped, this covers static geometry and
+            // bodies inside sleeping islands
+            bool node1Active = node1.collider->body->type != BodyType::sm2d_Static &&
+                               node1.collider->body->awake;
+            bool node2Active = node2.collider->body->type != BodyType::sm2d_Static &&
+                               node2.collider->body->awake;
+
+            if ((node1Active || node2Active) &&
+                ShouldCollide(node1.collider->filter, node2.collider->filter))
             {
-                data = TestColPolygonPolygon(*node1.collider, *node2.collider);
+                pairs.push_back({node1.collider, node2.collider});
             }
-            else if (node1.collider->type == ColliderType::sm2d_Polygon &&
-                     node2.collider->type == ColliderType::sm2d_AABB)
+            return;
+        }
+
+        if (node1Index == node2Index)
+        {
+            // A subtree against itself, visit each pair of children once so that every pair of
+            // colliders ends up in the results only once, and a leaf never collides with itself
+            if (!node1.leaf)
             {
-                data = TestColAABBPolygon(*node2.collider, *node1.collider);
+                CheckCollisions(node1.child1, node1.child1);
+                CheckCollisions(node1.child1, node1.child2);
+                CheckCollisions(node1.child2, node1.child2);
             }
-            else if (node1.collider->type == ColliderType::sm2d_AABB &&
-                     node2.collider->type == ColliderType::sm2d_Polygon)
+        }
+        else if (!node1.leaf && !node2.leaf)
+        {
+            // Check combinations of children for both internal nodes
+            CheckCollisions(node1.child1, node2.child1);
+            CheckCollisions(node1.child1, node2.child2);
+            CheckCollisions(node1.child2, node2.child1);
+            CheckCollisions(node1.child2, node2.child2);
+        }
+        else if (!node1.leaf)
+        {
+            // One node is internal, the other is a leaf
+            CheckCollisions(node1.child1, node2Index);
+            CheckCollisions(node1.child2, node2Index);
+        }
+        else // node2 is internal
+        {
+            CheckCollisions(node1Index, node2.child1);
+            CheckCollisions(node1Index, node2.child2);
+        }
+    };
+
+    // Start by checking the root node against itself and all other nodes
+    CheckCollisions(tree.rootIndex, tree.rootIndex);
+}
+
+void GetPairsInTree(const Tree& dynamicTree, const Tree& staticTree, std::vector<Pair>& pairs)
+{
+    GetPairsInTree(dynamicTree, pairs);
+
+    if (staticTree.nodes.empty() || staticTree.rootIndex == -1)
+        return;
+
+    // Each awake leaf walks the static tree on its own, kept between frames so it doesn't allocate
+    static thread_local std::vector<int> stack;
+
+    for (const Node& leaf : dynamicTree.nodes)
+    {
+        if (!leaf.leaf || leaf.collider == nullptr || !leaf.collider->body->awake ||
+            leaf.collider->body->type == BodyType::sm2d_Static)
+        {
+            continue;
+        }
+
+        stack.push_back(staticTree.rootIndex);
+        while (!stack.empty())
+        {
+            const Node& node = staticTree.nodes[stack.back()];
+            stack.pop_back();
+
+            if ((node.categoryBits & leaf.maskBits) == 0 ||
+                (leaf.categoryBits & node.maskBits) == 0 || !AABBTest(node.box, leaf.box))
             {
-                data = TestColAABBPolygon(*node1.collider, *node2.collider);
+                continue;
             }
-            else if (node1.collider->type == ColliderType::sm2d_Polygon &&
-                     node2.collider->type == ColliderType::sm2d_Circle)
+
+            if (node.leaf)
             {
-                data = TestColCirclePolygon(*node2.collider, *node1.collider);
+                if (ShouldCollide(leaf.collider->filter, node.collider->filter))
+                {
+                    pairs.push_back({leaf.collider, node.collider});
+                }
             }
-            else if (node1.collider->type == ColliderType::sm2d_Circle &&
-                     node2.collider->type == ColliderType::sm2d_Polygon)
+            else
             {
-                data = TestColCirclePolygon(*node1.collider, *node2.collider);
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
             }
-            else if (node1.collider->type == ColliderType::sm2d_Circle &&
-                     node2.collider->type == ColliderType::sm2d_Circle)
+        }
+    }
+}
+
+void ComputeManifolds(World& world, const std::vector<Pair>& pairs,
+                      std::vector<Manifold>& collisionResults)
+{
+    // One buffer per range of pairs so the workers never share a vector, they're kept between
+    // frames to avoid reallocating them
+    std::vector<std::vector<Manifold>>& manifoldBuffers = world.buffers.manifolds;
+
+    ThreadPool& pool = GetThreadPool();
+    int         rangeCount = pool.GetRangeCount((int)pairs.size(), SM_NARROWPHASE_MIN_PAIRS);
+
+    if ((int)manifoldBuffers.size() < rangeCount)
+    {
+        manifoldBuffers.resize(rangeCount);
+    }
+
+    auto NarrowPhase = [&](int begin, int end, int range)
+    {
+        std::vector<Manifold>& buffer = manifoldBuffers[range];
+        buffer.clear();
+
+        for (int i = begin; i < end; ++i)
+        {
+            Manifold data = TestCollision(*pairs[i].colliderA, *pairs[i].colliderB);
+            if (data)
             {
-                data = TestColCircleCircle(*node1.collider, *node2.collider);
+                buffer.push_back(data);
             }
-            else if (node1.collider->type == ColliderType::sm2d_Circle &&
-                     node2.collider->type == ColliderType::sm2d_AABB)
+        }
+    };
+
+    pool.ParallelFor((int)pairs.size(), SM_NARROWPHASE_MIN_PAIRS, NarrowPhase);
+
+    // Merging the buffers in range order keeps the results in the same order as the pairs
+    for (int i = 0; i < rangeCount; ++i)
+    {
+        collisionResults.insert(collisionResults.end(), manifoldBuffers[i].begin(),
+                                manifoldBuffers[i].end());
+    }
+}
+
+static bool SensorEventLess(const SensorEvent& a, const SensorEvent& b)
+{
+    std::less<Collider*> less;
+    return a.sensor != b.sensor ? less(a.sensor, b.sensor) : less(a.visitor, b.visitor);
+}
+
+// Diffs this step's sensor overlaps against the last step's into the begin and end events
+static void UpdateSensorEvents(World& world, const std::vector<Manifold>& overlaps)
+{
+    std::vector<SensorEvent>& sensorBeginEvents = world.sensorBeginEvents;
+    std::vector<SensorEvent>& sensorEndEvents = world.sensorEndEvents;
+    std::vector<SensorEvent>& sensorOverlaps = world.sensorOverlaps;
+    std::vector<SensorEvent>& previousOverlaps = world.buffers.previousOverlaps;
+    std::vector<SensorEvent>& sortedPrevious = world.buffers.sortedPrevious;
+    std::vector<SensorEvent>& sortedCurrent = world.buffers.sortedCurrent;
+
+    sensorBeginEvents.clear();
+    sensorEndEvents.clear();
+    previousOverlaps.swap(sensorOverlaps);
+    sensorOverlaps.clear();
+
+    for (const Manifold& overlap : overlaps)
+    {
+        if (overlap.objectA->sensor)
+        {
+            sensorOverlaps.push_back({overlap.objectA, overlap.objectB});
+        }
+        else
+        {
+            sensorOverlaps.push_back({overlap.objectB, overlap.objectA});
+        }
+    }
+
+    if (previousOverlaps.empty() && sensorOverlaps.empty())
+        return;
+
+    // Sorted copies to look the overlaps up in, the events keep the order the pairs were found in
+    sortedPrevious.assign(previousOverlaps.begin(), previousOverlaps.end());
+    sortedCurrent.assign(sensorOverlaps.begin(), sensorOverlaps.end());
+    std::sort(sortedPrevious.begin(), sortedPrevious.end(), SensorEventLess);
+    std::sort(sortedCurrent.begin(), sortedCurrent.end(), SensorEventLess);
+
+    for (const SensorEvent& overlap : sensorOverlaps)
+    {
+        if (!std::binary_search(sortedPrevious.begin(), sortedPrevious.end(), overlap,
+                                SensorEventLess))
+        {
+            sensorBeginEvents.push_back(overlap);
+        }
+    }
+
+    for (const SensorEvent& overlap : previousOverlaps)
+    {
+        if (std::binary_search(sortedCurrent.begin(), sortedCurrent.end(), overlap,
+                               SensorEventLess))
+        {
+            continue;
+        }
+
+        // The broadphase doesn't look for pairs where neither body can move, so those overlaps
+        // can't have ended and are kept as they were
+        bool sensorActive =
+            overlap.sensor->body->type != BodyType::sm2d_Static && overlap.sensor->body->awake;
+        bool visitorActive =
+            overlap.visitor->body->type != BodyType::sm2d_Static && overlap.visitor->body->awake;
+
+        if (sensorActive || visitorActive)
+        {
+            sensorEndEvents.push_back(overlap);
+        }
+        else
+        {
+            sensorOverlaps.push_back(overlap);
+        }
+    }
+}
+
+void CollidePairs(World& world, const std::vector<Pair>& pairs,
+                  std::vector<Manifold>& collisionResults)
+{
+    std::vector<Pair>&     solidPairs = world.buffers.solidPairs;
+    std::vector<Pair>&     sensorPairs = world.buffers.sensorPairs;
+    std::vector<Manifold>& sensorResults = world.buffers.sensorResults;
+
+    sensorPairs.clear();
+    sensorResults.clear();
+
+    // Most steps have no sensor pairs at all, so the pairs are only copied when there are some
+    const std::vector<Pair>* collidingPairs = &pairs;
+    auto firstSensorPair =
+        std::find_if(pairs.begin(), pairs.end(), [](const Pair& pair)
+                     { return pair.colliderA->sensor || pair.colliderB->sensor; });
+
+    if (firstSensorPair != pairs.end())
+    {
+        solidPairs.assign(pairs.begin(), firstSensorPair);
+        for (auto pair = firstSensorPair; pair != pairs.end(); ++pair)
+        {
+            bool sensorA = pair->colliderA->sensor;
+            bool sensorB = pair->colliderB->sensor;
+
+            if (!sensorA && !sensorB)
             {
-                data = TestColAABBCircle(*node2.collider, *node1.collider);
+                solidPairs.push_back(*pair);
             }
-            else if (node1.collider->type == ColliderType::sm2d_AABB &&
-                     node2.collider->type == ColliderType::sm2d_Circle)
+            else if (sensorA != sensorB) // Sensors don't detect each other
             {
-                data = TestColAABBCircle(*node1.collider, *node2.collider);
+                sensorPairs.push_back(*pair);
             }
+        }
+        collidingPairs = &solidPairs;
+    }
 
-            if (data)
-            {
-                bool node1Moved = node1.collider->body->hasMoved &&
-                                  !node1.collider->body->type == BodyType::sm2d_Static;
-                bool node2Moved = node2.collider->body->hasMoved &&
-                                  !node2.collider->body->type == BodyType::sm2d_Static;
+    ComputeManifolds(world, sensorPairs, sensorResults);
+    UpdateSensorEvents(world, sensorResults);
 
-                if (node1Moved && !node2Moved)
-                {
-                    node2.collider->body->awake = true;
-                }
-                else if (node2Moved && !node1Moved)
-                {
-                    node1.collider->body->awake = true;
-                }
-                else if (!node1Moved && !node2Moved)
-                {
-                    // Skip pushing the result if neither has moved
-                    node1.collider->body->awake = false;
-                    node2.collider->body->awake = false;
-                    return;
-                }
+    size_t firstResult = collisionResults.size();
+    ComputeManifolds(world, *collidingPairs, collisionResults);
 
-                collisionResults.push_back(data);
-            }
-            return;
+    // An awake body touching a sleeping one wakes up the whole island it rests in, this is done
+    // after the narrowphase so the workers never touch the islands
+    for (size_t i = firstResult; i < collisionResults.size(); ++i)
+    {
+        Rigidbody* rigid1 = collisionResults[i].objectA->body;
+        Rigidbody* rigid2 = collisionResults[i].objectB->body;
+
+        if (!rigid1->awake)
+        {
+            WakeBody(rigid1);
+        }
+        if (!rigid2->awake)
+        {
+            WakeBody(rigid2);
         }
+    }
+}
+
+void UpdateIslands(World& world, float deltaTime)
+{
+    std::vector<Island>& islands = world.islands;
 
-        // If one or both nodes are internal nodes, recurse further
-        if (!node1.leaf && !node2.leaf)
+    // Gather the awake bodies, their islandIndex is used as their union-find slot while building.
+    // Sleeping islands keep their membership from when they fell asleep
+    for (Node& node : world.dynamicTree.nodes)
+    {
+        // A body that got its awake flag set by hand pulls the rest of its island with it
+        if (node.leaf && node.collider != nullptr && node.collider->body->awake &&
+            node.collider->body->islandIndex != -1)
         {
-            // Check combinations of children for both internal nodes
-            CheckCollisions(node1.child1, node2.child1);
-            CheckCollisions(node1.child1, node2.child2);
-            CheckCollisions(node1.child2, node2.child1);
-            CheckCollisions(node1.child2, node2.child2);
+            WakeBody(node.collider->body);
         }
-        else if (!node1.leaf)
+    }
+
+    std::vector<Rigidbody*>& bodies = world.buffers.islandBodies;
+    bodies.clear();
+    for (Node& node : world.dynamicTree.nodes)
+    {
+        if (!node.leaf || node.collider == nullptr)
+            continue;
+
+        // Bodies with more than one collider only get gathered once
+        Rigidbody* body = node.collider->body;
+        if (body->type == BodyType::sm2d_Static || !body->awake || body->islandIndex != -1)
+            continue;
+
+        // The speed is measured from how far the body actually moved this step, a single pass of
+        // the solver leaves some velocity in stacks that the position correction cancels out
+        glm::vec2 position = glm::vec2(body->transform->position);
+        float     rotation = body->transform->rotation.z;
+        float     maxDistance = SM_LINEAR_SLEEP_TOLERANCE * deltaTime;
+        float     maxAngle = SM_ANGULAR_SLEEP_TOLERANCE * deltaTime;
+
+        if (glm::length2(position - body->previousPosition) > maxDistance * maxDistance ||
+            std::abs(rotation - body->previousRotation) > maxAngle)
         {
-            // One node is internal, the other is a leaf
-            CheckCollisions(node1.child1, node2Index);
-            CheckCollisions(node1.child2, node2Index);
+            body->sleepTime = 0.0f;
         }
-        else // node2 is internal
+        else
         {
-            CheckCollisions(node1Index, node2.child1);
-            CheckCollisions(node1Index, node2.child2);
+            body->sleepTime += deltaTime;
         }
+
+        body->islandIndex = (int)bodies.size();
+        bodies.push_back(body);
+    }
+
+    int bodyCount = (int)bodies.size();
+
+    std::vector<int>& parents = world.buffers.islandParents;
+    parents.resize(bodyCount);
+    for (int i = 0; i < bodyCount; ++i) { parents[i] = i; }
+
+    auto FindRoot = [&](int i)
+    {
+        while (parents[i] != i)
+        {
+            parents[i] = parents[parents[i]]; // Path halving
+            i = parents[i];
+        }
+        return i;
     };
 
-    // Start by checking the root node against itself and all other nodes
-    CheckCollisions(tree.rootIndex, tree.rootIndex);
+    // Link the bodies of every contact, static and kinematic bodies don't propagate islands
+    for (const Manifold& colData : world.contacts)
+    {
+        Rigidbody* rigid1 = colData.objectA->body;
+        Rigidbody* rigid2 = colData.objectB->body;
+
+        if (rigid1->type != BodyType::sm2d_Dynamic || rigid2->type != BodyType::sm2d_Dynamic ||
+            rigid1->islandIndex == -1 || rigid2->islandIndex == -1)
+        {
+            continue;
+        }
+
+        int root1 = FindRoot(rigid1->islandIndex);
+        int root2 = FindRoot(rigid2->islandIndex);
+        if (root1 != root2)
+        {
+            parents[root2] = root1;
+        }
+    }
+
+    // An island can only sleep once the most restless body in it has been resting long enough
+    std::vector<float>& islandSleepTimes = world.buffers.islandSleepTimes;
+    islandSleepTimes.assign(bodyCount, FLT_MAX);
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        int root = FindRoot(i);
+        islandSleepTimes[root] = MinFloat(islandSleepTimes[root], bodies[i]->sleepTime);
+    }
+
+    std::vector<int>& islandSlots = world.buffers.islandSlots;
+    islandSlots.assign(bodyCount, -1);
+    for (int i = 0; i < bodyCount; ++i)
+    {
+        Rigidbody* body = bodies[i];
+        int        root = FindRoot(i);
+
+        if (islandSleepTimes[root] < SM_TIME_TO_SLEEP)
+        {
+            body->islandIndex = -1;
+            continue;
+        }
+
+        if (islandSlots[root] == -1)
+        {
+            // Reuse the slot of an island that has been woken up
+            auto freeSlot = std::find_if(islands.begin(), islands.end(),
+                                         [](const Island& island) { return island.bodies.empty(); });
+            if (freeSlot == islands.end())
+            {
+                islands.emplace_back();
+                freeSlot = islands.end() - 1;
+            }
+            islandSlots[root] = (int)(freeSlot - islands.begin());
+        }
+
+        body->awake = false;
+        body->hasMoved = false;
+        body->linearVelocity = glm::vec2(0.0f);
+        body->angularVelocity = 0.0f;
+        body->islandIndex = islandSlots[root];
+        islands[body->islandIndex].bodies.push_back(body);
+
+        // The next load sees it's asleep and stops stepping it
+        MarkBodyDirty(body);
+    }
+}
+
+void WakeBody(Rigidbody* body)
+{
+    if (body->type == BodyType::sm2d_Static)
+        return;
+
+    if (body->islandIndex == -1)
+    {
+        // A body that wasn't moving has a stale slot in the body storage
+        if (!body->awake)
+        {
+            MarkBodyDirty(body);
+        }
+
+        body->awake = true;
+        body->sleepTime = 0.0f;
+        return;
+    }
+
+    // Only a body in a world can be in an island
+    Island& island = body->world->islands[body->islandIndex];
+    for (Rigidbody* member : island.bodies)
+    {
+        member->awake = true;
+        member->sleepTime = 0.0f;
+        member->islandIndex = -1;
+        MarkBodyDirty(member);
+    }
+    island.bodies.clear();
+}
+
+void ApplyForce(Rigidbody* body, const glm::vec2& force)
+{
+    WakeBody(body);
+    body->force += force;
+
+    // The world integrates its own copy of the force, dirty bodies get theirs when they're loaded
+    if (body->world != nullptr && !body->dirty)
+    {
+        body->world->bodies.forceX[body->bodyIndex] += force.x;
+        body->world->bodies.forceY[body->bodyIndex] += force.y;
+    }
+}
+
+void ApplyTorque(Rigidbody* body, float torque)
+{
+    WakeBody(body);
+    body->torque += torque;
+
+    if (body->world != nullptr && !body->dirty)
+    {
+        body->world->bodies.torque[body->bodyIndex] += torque;
+    }
+}
+
+bool ShouldCollide(const Filter& filterA, const Filter& filterB)
+{
+    if (filterA.groupIndex == filterB.groupIndex && filterA.groupIndex != 0)
+    {
+        return filterA.groupIndex > 0;
+    }
+
+    return (filterA.categoryBits & filterB.maskBits) != 0 &&
+           (filterB.categoryBits & filterA.maskBits) != 0;
+}
+
+void SetFilter(World& world, Collider& collider, const Filter& filter)
+{
+    collider.filter = filter;
+
+    if (collider.type == ColliderType::sm2d_Chain)
+    {
+        for (Collider* segment : collider.chain.segments)
+        {
+            SetFilter(world, *segment, filter);
+        }
+        return;
+    }
+
+    // Colliders that aren't in a tree yet, like static ones waiting for the static tree to be
+    // built, get their bits when they're put in one
+    if (collider.treeIndex == -1)
+        return;
+
+    Tree& tree =
+        collider.body->type == BodyType::sm2d_Static ? world.staticTree : world.dynamicTree;
+
+    Node& leaf = tree.nodes[collider.treeIndex];
+    SetLeafFilterBits(leaf);
+
+    for (int nodeIndex = leaf.parentIndex; nodeIndex != -1;
+         nodeIndex = tree.nodes[nodeIndex].parentIndex)
+    {
+        Node&       node = tree.nodes[nodeIndex];
+        const Node& child1 = tree.nodes[node.child1];
+        const Node& child2 = tree.nodes[node.child2];
+        node.categoryBits = child1.categoryBits | child2.categoryBits;
+        node.maskBits = child1.maskBits | child2.maskBits;
+    }
 }
 
 float CrossProduct(const glm::vec2& a, const glm::vec2& b)
@@ -678,7 +1350,7 @@ float CrossProduct(const glm::vec2& a, const glm::vec2& b)
     return a.x * b.y - a.y * b.x;
 }
 
-void ResolveCollisions(const Tree& tree, std::vector<Manifold>& collisionResults)
+void ResolveCollisions(std::vector<Manifold>& collisionResults)
 {
     for (auto& colData : collisionResults)
     {
@@ -687,23 +1359,34 @@ void ResolveCollisions(const Tree& tree, std::vector<Manifold>& collisionResults
         Rigidbody* rigid1 = objectA->body;
         Rigidbody* rigid2 = objectB->body;
 
+        // Only dynamic bodies get pushed, the rest act as if they had infinite mass. Chains put a
+        // whole level on one static body, so its inertia about a far away origin can't count
+        float inverseMassA = rigid1->type == BodyType::sm2d_Dynamic ? 1.0f / rigid1->mass : 0.0f;
+        float inverseMassB = rigid2->type == BodyType::sm2d_Dynamic ? 1.0f / rigid2->mass : 0.0f;
+        float inverseInertiaA = rigid1->type == BodyType::sm2d_Dynamic && !rigid1->fixedRotation
+                                    ? 1.0f / rigid1->momentOfInertia
+                                    : 0.0f;
+        float inverseInertiaB = rigid2->type == BodyType::sm2d_Dynamic && !rigid2->fixedRotation
+                                    ? 1.0f / rigid2->momentOfInertia
+                                    : 0.0f;
+
+        float inverseMassSum = inverseMassA + inverseMassB;
+        if (inverseMassSum <= 0.0f)
+            continue;
+
         // Position correction
-        float totalMass = rigid1->mass + rigid2->mass;
-        if (totalMass > 0.0f)
         {
             const float penetrationTolerance = 0.005f; // Adjust this value as needed
             float correctionMagnitude = std::max(0.0f, 
                 colData.penetrationDepth - penetrationTolerance) * 0.8f; // Bias factor
 
-            glm::vec2 correctionA = -(correctionMagnitude / totalMass) * 
-                colData.collisionNormal * rigid2->mass;
-            glm::vec2 correctionB = +(correctionMagnitude / totalMass) * 
-                colData.collisionNormal * rigid1->mass;
+            glm::vec2 correctionA = -(correctionMagnitude / inverseMassSum) * 
+                colData.collisionNormal * inverseMassA;
+            glm::vec2 correctionB = +(correctionMagnitude / inverseMassSum) * 
+                colData.collisionNormal * inverseMassB;
 
-            if (rigid1->type == BodyType::sm2d_Dynamic)
-                rigid1->transform->position += glm::vec3(correctionA, 0.0f);
-            if (rigid2->type == BodyType::sm2d_Dynamic)
-                rigid2->transform->position += glm::vec3(correctionB, 0.0f);
+            rigid1->transform->position += glm::vec3(correctionA, 0.0f);
+            rigid2->transform->position += glm::vec3(correctionB, 0.0f);
         }
 
         // Velocity resolution
@@ -725,37 +1408,32 @@ void ResolveCollisions(const Tree& tree, std::vector<Manifold>& collisionResults
             float rACrossN = CrossProduct(rA, colData.collisionNormal);
             float rBCrossN = CrossProduct(rB, colData.collisionNormal);
             
-            float angularFactor = (rACrossN * rACrossN) / rigid1->momentOfInertia +
-                                (rBCrossN * rBCrossN) / rigid2->momentOfInertia;
+            float angularFactor = rACrossN * rACrossN * inverseInertiaA +
+                                rBCrossN * rBCrossN * inverseInertiaB;
 
             // Dampen angular impulse for vertex collisions
             float vertexCollisionDamping = 0.7f; // Adjust this value to control angular damping
             angularFactor *= vertexCollisionDamping;
 
             float impulseMagnitude = -(1 + e) * velocityAlongNormal /
-                ((1.0f / rigid1->mass + 1.0f / rigid2->mass) + angularFactor);
+                (inverseMassSum + angularFactor);
 
             glm::vec2 impulse = impulseMagnitude * colData.collisionNormal;
 
             // Apply linear impulses
-            if (rigid1->type == BodyType::sm2d_Dynamic)
-                rigid1->linearVelocity -= impulse / rigid1->mass;
-            if (rigid2->type == BodyType::sm2d_Dynamic)
-                rigid2->linearVelocity += impulse / rigid2->mass;
+            rigid1->linearVelocity -= impulse * inverseMassA;
+            rigid2->linearVelocity += impulse * inverseMassB;
 
             // Apply angular impulses with damping
-            if (rigid1->type == BodyType::sm2d_Dynamic && !rigid1->fixedRotation)
-            {
-                float torqueA = CrossProduct(rA, -impulse);
-                rigid1->angularVelocity += (torqueA / rigid1->momentOfInertia) * vertexCollisionDamping;
-            }
-
-            if (rigid2->type == BodyType::sm2d_Dynamic && !rigid2->fixedRotation)
-            {
-                float torqueB = CrossProduct(rB, impulse);
-                rigid2->angularVelocity += (torqueB / rigid2->momentOfInertia) * vertexCollisionDamping;
-            }
+            rigid1->angularVelocity +=
+                CrossProduct(rA, -impulse) * inverseInertiaA * vertexCollisionDamping;
+            rigid2->angularVelocity +=
+                CrossProduct(rB, impulse) * inverseInertiaB * vertexCollisionDamping;
         }
+
+        // This solver works on the rigidbodies, the world's copy has to follow
+        CopyBodyToStorage(rigid1);
+        CopyBodyToStorage(rigid2);
     }
 }
 
@@ -776,6 +1454,34 @@ AABB ColCircleToABBB(const Collider& circle)
     return AABB(topRight, bottomLeft);
 }
 
+AABB ColliderToAABB(const Collider& collider)
+{
+    if (collider.type == ColliderType::sm2d_AABB)
+    {
+        return ColAABBToABBB(collider);
+    }
+    else if (collider.type == ColliderType::sm2d_Circle)
+    {
+        return ColCircleToABBB(collider);
+    }
+    else if (collider.type == ColliderType::sm2d_Segment)
+    {
+        return ColSegmentToAABB(collider);
+    }
+    else if (collider.type == ColliderType::sm2d_Chain)
+    {
+        // Chains aren't in a tree themselves, this is the box around their segments
+        AABB box = AABB(glm::vec2(-FLT_MAX), glm::vec2(FLT_MAX));
+        for (const Collider* segment : collider.chain.segments)
+        {
+            box = AABBUnion(box, ColSegmentToAABB(*segment));
+        }
+        return box;
+    }
+
+    return ColPolygonToAABB(collider);
+}
+
 AABB ColPolygonToAABB(const Collider& poly)
 {
     glm::vec2 upperBound = glm::vec2(poly.body->transform->position);
@@ -790,4 +1496,11 @@ AABB ColPolygonToAABB(const Collider& poly)
     return AABB(upperBound, lowerBound);
 }
 
+AABB ColSegmentToAABB(const Collider& segment)
+{
+    const ColSegment& data = segment.segment;
+    return AABB(glm::max(data.worldPoint1, data.worldPoint2),
+                glm::min(data.worldPoint1, data.worldPoint2));
+}
+
 } // namespace sm2d
@@ -2,6 +2,7 @@
 
 #include <sm2d/types.h>
 #include <sm2d/colliders.h>
+#include <sm2d/world.h>
 #include <optional>
 
 namespace sm2d
@@ -18,14 +19,25 @@ glm::vec2 ClosestPointOnLineSegment(const glm::vec2& vertex, const glm::vec2& li
 // Transforms a point from object space into world space
 glm::vec2 LocalToWorld(glm::vec2 point, const glm::vec2 pos, float cosine, float sine);
 
-// Updates a polygon's vertices to match its world space position and rotation
+// Updates a polygon's vertices, edge normals and center to match its world space position and
+// rotation, from the object space data cached when the collider was created
 void UpdatePolygon(Collider& poly);
 
-// Computes the geometric center of a polygon
+// Updates a segment's points and normal to match its world space position and rotation
+void UpdateSegment(Collider& segment);
+
+// Brings a collider's world space data up to date if its body moved since the last time, returns
+// true if it moved. Resting bodies skip the transform and keep their tree leaf
+bool SyncCollider(Collider& collider);
+
+// Computes the geometric center of a polygon from its world points
 glm::vec2 ComputePolygonCenter(ColPolygon& poly);
 
-// Computes the top, down, left and right points of an AABB collider
-void ComputeAABBPoints(const Collider& collider, std::vector<glm::vec2>& points);
+// Computes the corners of an AABB collider in clockwise order, starting at the bottom left
+void ComputeAABBPoints(const Collider& collider, glm::vec2 points[4]);
+
+// Fills in the polygon form of an AABB collider so it can go through the polygon code paths
+void ComputeAABBPolygon(const Collider& collider, PolygonSoA& box);
 
 // Cross product between vector and a scalar
 glm::vec2 VectorScalarCross(const glm::vec2& v, float s);
@@ -60,17 +72,59 @@ void InsertLeaf(Tree& tree, Collider* body, const AABB& box);
 // Finds the best sibling for a new leaf
 int FindBestSibling(Tree& tree, const AABB& box);
 
-// Removes a rigidbody from a tree
+// Removes a rigidbody from a tree, its leaf and the leaf's parent go on the tree's free list
 void RemoveLeaf(Tree& tree, int leafIndex);
 
-// Removes all the marked leaves from the tree's vector of nodes
-void RemoveDeletedLeaves(Tree& tree);
+// Builds a tree from scratch, top down, splitting the colliders where the surface area heuristic
+// says to. Slower than inserting them one by one but gives a better tree, so it suits colliders
+// that rarely move like the static ones. Colliders are synced before their boxes are taken
+void BuildTree(Tree& tree, const std::vector<Collider*>& colliders);
+
+// Builds a tree again from the colliders that are already in it, call it after they've changed
+void RebuildTree(Tree& tree);
+
+// Traverses through a tree and puts every pair of leaves with overlapping AABBs into pairs,
+// pairs where neither body can move are left out
+void GetPairsInTree(const Tree& tree, std::vector<Pair>& pairs);
+
+// Puts the pairs of the dynamic tree against itself and of its awake leaves against the static
+// tree into pairs. Static colliders are never paired with each other
+void GetPairsInTree(const Tree& dynamicTree, const Tree& staticTree, std::vector<Pair>& pairs);
+
+// Runs the narrowphase on the pairs in parallel and appends the collisions to collisionResults,
+// they end up in the same order as the pairs no matter how many threads are used. The workers
+// write into the world's buffers
+void ComputeManifolds(World& world, const std::vector<Pair>& pairs,
+                      std::vector<Manifold>& collisionResults);
 
-// Traverses through a tree and detects all the collisions and puts them in collisionResults
-void GetCollisionsInTree(const Tree& tree, std::vector<Manifold>& collisionResults);
+// Runs the narrowphase on the pairs, puts the collisions in collisionResults and wakes the sleeping
+// bodies that got hit. Pairs with a sensor are only tested for overlap, they never end up in
+// collisionResults, they're diffed against the last step's overlaps into the world's sensor events
+void CollidePairs(World& world, const std::vector<Pair>& pairs,
+                  std::vector<Manifold>& collisionResults);
 
 // Resolves all collisions based on the given ColiisionData
-void ResolveCollisions(const Tree& tree, std::vector<Manifold>& collisionResults);
+void ResolveCollisions(std::vector<Manifold>& collisionResults);
+
+// Builds contact islands from the world's contacts with union-find, islands whose bodies have all
+// been resting for SM_TIME_TO_SLEEP seconds are put to sleep as a unit
+void UpdateIslands(World& world, float deltaTime);
+
+// Wakes up a body and every other body in its sleeping island
+void WakeBody(Rigidbody* body);
+
+// Adds a force to the body, waking it up if it's asleep
+void ApplyForce(Rigidbody* body, const glm::vec2& force);
+
+// Adds a torque to the body, waking it up if it's asleep
+void ApplyTorque(Rigidbody* body, float torque);
+
+// Returns true if colliders with these filters can collide
+bool ShouldCollide(const Filter& filterA, const Filter& filterB);
+
+// Changes a collider's filter and updates the filter bits of the tree nodes above it, a chain
+// passes it on to its segments
+void SetFilter(World& world, Collider& collider, const Filter& filter);
 
 // Returns the 2d cross product of two vectors
 float CrossProduct(const glm::vec2& a, const glm::vec2& b);
@@ -81,5 +135,7 @@ AABB ColAABBToABBB(const Collider& box);      // Returns bounding box encapsulat
 AABB ColCircleToABBB(const Collider& circle); // Returns bounding box encapsulating a Circle
 AABB ColPolygonToAABB(
     const Collider& poly); // Returns bounding box encapsulating a Polygon collider
+AABB ColSegmentToAABB(const Collider& segment); // Returns bounding box of a chain segment
+AABB ColliderToAABB(const Collider& collider); // Returns bounding box of any type of collider
 
 } // namespace sm2d
@@ -0,0 +1,491 @@
+#include <sm2d/queries.h>
+#include <sm2d/functions.h>
+#include <sm2d/thread_pool.h>
+#include <cfloat>
+#include <cmath>
+
+namespace sm2d
+{
+
+// Every thread keeps its own traversal stack so that queries can run in parallel, it keeps its
+// capacity between queries so it stops allocating once it's as deep as the tree
+static std::vector<int>& GetQueryStack()
+{
+    static thread_local std::vector<int> stack;
+    stack.clear();
+    return stack;
+}
+
+// Slab test of the cast against a box grown by the cast's radius, limited to [0, maxFraction]
+static bool CastOverlapsBox(const AABB& box, const CastInput& input, float maxFraction)
+{
+    glm::vec2 lowerBound = box.lowerBound - input.radius;
+    glm::vec2 upperBound = box.upperBound + input.radius;
+
+    float minFraction = 0.0f;
+
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        float origin = input.origin[axis];
+        float translation = input.translation[axis];
+
+        if (std::abs(translation) < FLT_EPSILON)
+        {
+            // Parallel to the slab, it has to start between the two sides
+            if (origin < lowerBound[axis] || origin > upperBound[axis])
+                return false;
+
+            continue;
+        }
+
+        float inverse = 1.0f / translation;
+        float t1 = (lowerBound[axis] - origin) * inverse;
+        float t2 = (upperBound[axis] - origin) * inverse;
+        if (t1 > t2)
+        {
+            std::swap(t1, t2);
+        }
+
+        minFraction = MaxFloat(minFraction, t1);
+        maxFraction = MinFloat(maxFraction, t2);
+        if (minFraction > maxFraction)
+            return false;
+    }
+
+    return true;
+}
+
+// Ray against a circle, misses if the ray starts inside the circle
+static bool CastCircle(float& fraction, const glm::vec2& center, float radius,
+                       const CastInput& input, float maxFraction)
+{
+    glm::vec2 offset = input.origin - center;
+
+    float c = glm::dot(offset, offset) - radius * radius;
+    if (c <= 0.0f)
+        return false;
+
+    float a = glm::dot(input.translation, input.translation);
+    if (a < FLT_EPSILON)
+        return false;
+
+    float b = glm::dot(offset, input.translation);
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.0f)
+        return false;
+
+    float t = (-b - std::sqrt(discriminant)) / a;
+    if (t < 0.0f || t > maxFraction)
+        return false;
+
+    fraction = t;
+    return true;
+}
+
+// Cast against a polygon rounded by the cast's radius. The edges pushed out by the radius are
+// clipped against the ray, if the entry point isn't on the flat part of an edge the cast has to
+// hit one of the rounded corners first
+static bool CastPolygon(CastHit& hit, const PolygonSoA& poly, const CastInput& input,
+                        float maxFraction)
+{
+    float lower = 0.0f;
+    float upper = maxFraction;
+    int   index = -1;
+
+    for (int i = 0; i < poly.count; ++i)
+    {
+        glm::vec2 normal = glm::vec2(poly.normalX[i], poly.normalY[i]);
+        glm::vec2 point = glm::vec2(poly.x[i], poly.y[i]) + input.radius * normal;
+
+        float numerator = glm::dot(normal, point - input.origin);
+        float denominator = glm::dot(normal, input.translation);
+
+        if (denominator == 0.0f)
+        {
+            // Parallel to the edge and outside of it
+            if (numerator < 0.0f)
+                return false;
+        }
+        else if (denominator < 0.0f && numerator < lower * denominator)
+        {
+            lower = numerator / denominator;
+            index = i;
+        }
+        else if (denominator > 0.0f && numerator < upper * denominator)
+        {
+            upper = numerator / denominator;
+        }
+
+        if (upper < lower)
+            return false;
+    }
+
+    // The cast started inside the polygon
+    if (index < 0)
+        return false;
+
+    glm::vec2 normal = glm::vec2(poly.normalX[index], poly.normalY[index]);
+    glm::vec2 surfacePoint = input.origin + lower * input.translation - input.radius * normal;
+
+    if (input.radius > 0.0f)
+    {
+        int       next = (index + 1) % poly.count;
+        glm::vec2 v1 = glm::vec2(poly.x[index], poly.y[index]);
+        glm::vec2 edge = glm::vec2(poly.x[next], poly.y[next]) - v1;
+        float     along = glm::dot(surfacePoint - v1, edge);
+
+        if (along < 0.0f || along > glm::dot(edge, edge))
+        {
+            int   corner = -1;
+            float cornerFraction = maxFraction;
+            for (int i = 0; i < poly.count; ++i)
+            {
+                glm::vec2 vertex = glm::vec2(poly.x[i], poly.y[i]);
+                float     fraction;
+                if (CastCircle(fraction, vertex, input.radius, input, cornerFraction))
+                {
+                    corner = i;
+                    cornerFraction = fraction;
+                }
+            }
+
+            if (corner < 0)
+                return false;
+
+            glm::vec2 vertex = glm::vec2(poly.x[corner], poly.y[corner]);
+            hit.fraction = cornerFraction;
+            hit.point = vertex;
+            hit.normal = glm::normalize(input.origin + cornerFraction * input.translation - vertex);
+            return true;
+        }
+    }
+
+    hit.fraction = lower;
+    hit.point = surfacePoint;
+    hit.normal = normal;
+    return true;
+}
+
+// One sided cast against a segment, only casts moving towards its front can hit it. The segment
+// is pushed out by the cast's radius and its ends are rounded
+static bool CastSegment(CastHit& hit, const ColSegment& segment, const CastInput& input,
+                        float maxFraction)
+{
+    glm::vec2 normal = segment.normal;
+
+    float denominator = glm::dot(normal, input.translation);
+    if (denominator >= 0.0f)
+        return false;
+
+    // A cast that starts behind the pushed out segment is behind it or inside the radius
+    float numerator =
+        glm::dot(normal, segment.worldPoint1 + input.radius * normal - input.origin);
+    if (numerator > 0.0f)
+        return false;
+
+    float fraction = numerator / denominator;
+    if (fraction > maxFraction)
+        return false;
+
+    glm::vec2 surfacePoint = input.origin + fraction * input.translation - input.radius * normal;
+    glm::vec2 edge = segment.worldPoint2 - segment.worldPoint1;
+    float     along = glm::dot(surfacePoint - segment.worldPoint1, edge);
+
+    if (along >= 0.0f && along <= glm::dot(edge, edge))
+    {
+        hit.fraction = fraction;
+        hit.point = surfacePoint;
+        hit.normal = normal;
+        return true;
+    }
+
+    if (input.radius <= 0.0f)
+        return false;
+
+    bool      hasCorner = false;
+    glm::vec2 corner;
+    float     cornerFraction = maxFraction;
+    for (glm::vec2 vertex : {segment.worldPoint1, segment.worldPoint2})
+    {
+        float vertexFraction;
+        if (CastCircle(vertexFraction, vertex, input.radius, input, cornerFraction))
+        {
+            hasCorner = true;
+            corner = vertex;
+            cornerFraction = vertexFraction;
+        }
+    }
+
+    if (!hasCorner)
+        return false;
+
+    hit.fraction = cornerFraction;
+    hit.point = corner;
+    hit.normal = glm::normalize(input.origin + cornerFraction * input.translation - corner);
+    return true;
+}
+
+static bool CastCollider(CastHit& hit, Collider& collider, const CastInput& input,
+                         float maxFraction)
+{
+    bool hasHit = false;
+
+    if (collider.type == ColliderType::sm2d_Circle)
+    {
+        glm::vec2 center = glm::vec2(collider.body->transform->position);
+        float     fraction;
+        if (CastCircle(fraction, center, collider.circle.radius + input.radius, input, maxFraction))
+        {
+            glm::vec2 normal = glm::normalize(input.origin + fraction * input.translation - center);
+            hit.fraction = fraction;
+            hit.normal = normal;
+            hit.point = center + collider.circle.radius * normal;
+            hasHit = true;
+        }
+    }
+    else if (collider.type == ColliderType::sm2d_AABB)
+    {
+        PolygonSoA box;
+        ComputeAABBPolygon(collider, box);
+        hasHit = CastPolygon(hit, box, input, maxFraction);
+    }
+    else if (collider.type == ColliderType::sm2d_Polygon)
+    {
+        hasHit = CastPolygon(hit, collider.polygon.world, input, maxFraction);
+    }
+    else if (collider.type == ColliderType::sm2d_Segment)
+    {
+        hasHit = CastSegment(hit, collider.segment, input, maxFraction);
+    }
+
+    if (hasHit)
+    {
+        hit.collider = &collider;
+    }
+
+    return hasHit;
+}
+
+static bool ColliderContainsPoint(const Collider& collider, const glm::vec2& point)
+{
+    glm::vec2 position = glm::vec2(collider.body->transform->position);
+
+    if (collider.type == ColliderType::sm2d_Circle)
+    {
+        glm::vec2 offset = point - position;
+        return glm::dot(offset, offset) <= collider.circle.radius * collider.circle.radius;
+    }
+    else if (collider.type == ColliderType::sm2d_AABB)
+    {
+        glm::vec2 offset = glm::abs(point - position);
+        return offset.x <= collider.aabb.halfwidths.x && offset.y <= collider.aabb.halfwidths.y;
+    }
+    else if (collider.type == ColliderType::sm2d_Polygon)
+    {
+        const PolygonSoA& poly = collider.polygon.world;
+        for (int i = 0; i < poly.count; ++i)
+        {
+            float separation = poly.normalX[i] * (point.x - poly.x[i]) +
+                               poly.normalY[i] * (point.y - poly.y[i]);
+            if (separation > 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+CastHit Raycast(const Tree& tree, const glm::vec2& origin, const glm::vec2& translation,
+                uint32_t maskBits)
+{
+    return Cast(tree, {origin, translation, 0.0f, maskBits});
+}
+
+CastHit CircleCast(const Tree& tree, const glm::vec2& origin, float radius,
+                   const glm::vec2& translation, uint32_t maskBits)
+{
+    return Cast(tree, {origin, translation, radius, maskBits});
+}
+
+CastHit Cast(const Tree& tree, const CastInput& input)
+{
+    CastHit result;
+
+    if (tree.nodes.empty() || tree.rootIndex == -1)
+        return result;
+
+    std::vector<int>& stack = GetQueryStack();
+    stack.push_back(tree.rootIndex);
+
+    // Shrinks every time something closer is hit, so the rest of the tree gets culled harder
+    float maxFraction = 1.0f;
+
+    while (!stack.empty())
+    {
+        const Node& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        if ((node.categoryBits & input.maskBits) == 0 ||
+            !CastOverlapsBox(node.box, input, maxFraction))
+        {
+            continue;
+        }
+
+        if (node.leaf)
+        {
+            if ((node.collider->filter.categoryBits & input.maskBits) == 0)
+                continue;
+
+            CastHit hit;
+            if (CastCollider(hit, *node.collider, input, maxFraction))
+            {
+                result = hit;
+                maxFraction = hit.fraction;
+            }
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+
+    return result;
+}
+
+void CastBatch(const Tree& tree, const std::vector<CastInput>& casts, std::vector<CastHit>& hits)
+{
+    hits.resize(casts.size());
+
+    GetThreadPool().ParallelFor((int)casts.size(), SM_QUERY_MIN_BATCH,
+                                [&](int begin, int end, int rangeIndex)
+                                {
+                                    for (int i = begin; i < end; ++i)
+                                    {
+                                        hits[i] = Cast(tree, casts[i]);
+                                    }
+                                });
+}
+
+void OverlapAABB(const Tree& tree, const AABB& box, std::vector<Collider*>& results,
+                 uint32_t maskBits)
+{
+    if (tree.nodes.empty() || tree.rootIndex == -1)
+        return;
+
+    std::vector<int>& stack = GetQueryStack();
+    stack.push_back(tree.rootIndex);
+
+    while (!stack.empty())
+    {
+        const Node& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        if ((node.categoryBits & maskBits) == 0 || !AABBTest(node.box, box))
+            continue;
+
+        if (node.leaf)
+        {
+            if ((node.collider->filter.categoryBits & maskBits) != 0)
+            {
+                results.push_back(node.collider);
+            }
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void QueryPoint(const Tree& tree, const glm::vec2& point, std::vector<Collider*>& results,
+                uint32_t maskBits)
+{
+    if (tree.nodes.empty() || tree.rootIndex == -1)
+        return;
+
+    std::vector<int>& stack = GetQueryStack();
+    stack.push_back(tree.rootIndex);
+
+    AABB pointBox = AABB(point, point);
+
+    while (!stack.empty())
+    {
+        const Node& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        if ((node.categoryBits & maskBits) == 0 || !AABBTest(node.box, pointBox))
+            continue;
+
+        if (node.leaf)
+        {
+            if ((node.collider->filter.categoryBits & maskBits) != 0 &&
+                ColliderContainsPoint(*node.collider, point))
+            {
+                results.push_back(node.collider);
+            }
+        }
+        else
+        {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+CastHit Raycast(const World& world, const glm::vec2& origin, const glm::vec2& translation,
+                uint32_t maskBits)
+{
+    return Cast(world, {origin, translation, 0.0f, maskBits});
+}
+
+CastHit CircleCast(const World& world, const glm::vec2& origin, float radius,
+                   const glm::vec2& translation, uint32_t maskBits)
+{
+    return Cast(world, {origin, translation, radius, maskBits});
+}
+
+CastHit Cast(const World& world, const CastInput& input)
+{
+    CastHit staticHit = Cast(world.staticTree, input);
+    CastHit dynamicHit = Cast(world.dynamicTree, input);
+
+    if (dynamicHit.collider != nullptr &&
+        (staticHit.collider == nullptr || dynamicHit.fraction < staticHit.fraction))
+    {
+        return dynamicHit;
+    }
+    return staticHit;
+}
+
+void CastBatch(const World& world, const std::vector<CastInput>& casts, std::vector<CastHit>& hits)
+{
+    hits.resize(casts.size());
+
+    GetThreadPool().ParallelFor((int)casts.size(), SM_QUERY_MIN_BATCH,
+                                [&](int begin, int end, int rangeIndex)
+                                {
+                                    for (int i = begin; i < end; ++i)
+                                    {
+                                        hits[i] = Cast(world, casts[i]);
+                                    }
+                                });
+}
+
+void OverlapAABB(const World& world, const AABB& box, std::vector<Collider*>& results,
+                 uint32_t maskBits)
+{
+    OverlapAABB(world.staticTree, box, results, maskBits);
+    OverlapAABB(world.dynamicTree, box, results, maskBits);
+}
+
+void QueryPoint(const World& world, const glm::vec2& point, std::vector<Collider*>& results,
+                uint32_t maskBits)
+{
+    QueryPoint(world.staticTree, point, results, maskBits);
+    QueryPoint(world.dynamicTree, point, results, maskBits);
+}
+
+} // namespace sm2d
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/world.h>
+#include <vector>
+
+#define SM_QUERY_MIN_BATCH (32) // Fewest casts a worker gets in CastBatch before threading
+
+namespace sm2d
+{
+
+// A ray when radius is zero, otherwise a circle swept from origin to origin + translation
+struct CastInput
+{
+    glm::vec2 origin;
+    glm::vec2 translation;
+    float     radius = 0.0f;
+    uint32_t  maskBits = SM_ALL_CATEGORY_BITS; // Categories the cast can hit
+};
+
+// The closest thing a cast ran into
+struct CastHit
+{
+    Collider* collider = nullptr; // nullptr if the cast didn't hit anything
+    glm::vec2 point;              // Where the cast touched the collider's surface
+    glm::vec2 normal;             // Surface normal of the collider at the point
+    float     fraction = 1.0f;    // How far along the translation the hit is, from 0 to 1
+};
+
+// Queries traverse the tree with an explicit stack and don't allocate once each thread's stack
+// has grown to the depth of the tree. Colliders that a cast starts inside of are ignored, so a
+// body can cast from its own center. Chain segments are only hit from their front and never
+// contain a point. Only colliders with a category in maskBits are found, and subtrees without any
+// of those categories aren't visited
+
+// Finds the closest collider along a ray from origin to origin + translation
+CastHit Raycast(const Tree& tree, const glm::vec2& origin, const glm::vec2& translation,
+                uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+// Finds the closest collider that a circle moving from origin to origin + translation touches
+CastHit CircleCast(const Tree& tree, const glm::vec2& origin, float radius,
+                   const glm::vec2& translation, uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+// Runs a ray or circle cast
+CastHit Cast(const Tree& tree, const CastInput& input);
+
+// Runs every cast in parallel on the sm2d thread pool, hits[i] is the result of casts[i]
+void CastBatch(const Tree& tree, const std::vector<CastInput>& casts, std::vector<CastHit>& hits);
+
+// Appends every collider whose bounding box overlaps the box to results
+void OverlapAABB(const Tree& tree, const AABB& box, std::vector<Collider*>& results,
+                 uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+// Appends every collider that contains the point to results
+void QueryPoint(const Tree& tree, const glm::vec2& point, std::vector<Collider*>& results,
+                uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+// The same queries over both trees of a world, casts return the closer of the two hits and the
+// static colliders come first in the results of the others
+
+CastHit Raycast(const World& world, const glm::vec2& origin, const glm::vec2& translation,
+                uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+CastHit CircleCast(const World& world, const glm::vec2& origin, float radius,
+                   const glm::vec2& translation, uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+CastHit Cast(const World& world, const CastInput& input);
+
+void CastBatch(const World& world, const std::vector<CastInput>& casts,
+               std::vector<CastHit>& hits);
+
+void OverlapAABB(const World& world, const AABB& box, std::vector<Collider*>& results,
+                 uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+void QueryPoint(const World& world, const glm::vec2& point, std::vector<Collider*>& results,
+                uint32_t maskBits = SM_ALL_CATEGORY_BITS);
+
+} // namespace sm2d
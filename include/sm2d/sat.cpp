@@ -0,0 +1,178 @@
+#include <sm2d/sat.h>
+#include <sm2d/functions.h>
+#include <sm2d/simd.h>
+#include <cassert>
+#include <cfloat>
+
+namespace sm2d
+{
+
+// Every kernel writes the separation of polygon 2 along all SM_MAX_POLYGON_VERTICES edge normals
+// of polygon 1, the lanes past the edge count of polygon 1 are ignored
+using SeparationKernel = void (*)(float* separations, const PolygonSoA& poly1,
+                                  const PolygonSoA& poly2);
+
+static void SeparationsScalar(float* separations, const PolygonSoA& poly1, const PolygonSoA& poly2)
+{
+    for (int i = 0; i < poly1.count; ++i)
+    {
+        float offset = poly1.normalX[i] * poly1.x[i] + poly1.normalY[i] * poly1.y[i];
+
+        float separation = FLT_MAX;
+        for (int j = 0; j < poly2.count; ++j)
+        {
+            float projection = poly1.normalX[i] * poly2.x[j] + poly1.normalY[i] * poly2.y[j];
+            separation = MinFloat(separation, projection);
+        }
+
+        separations[i] = separation - offset;
+    }
+}
+
+#ifdef SM_SIMD_X86
+
+// Four axes at a time, the second half is skipped for polygons with four edges or fewer
+static void SeparationsSSE(float* separations, const PolygonSoA& poly1, const PolygonSoA& poly2)
+{
+    for (int half = 0; half < SM_MAX_POLYGON_VERTICES; half += 4)
+    {
+        if (half >= poly1.count)
+            break;
+
+        __m128 normalX = _mm_loadu_ps(poly1.normalX + half);
+        __m128 normalY = _mm_loadu_ps(poly1.normalY + half);
+        __m128 offset = _mm_add_ps(_mm_mul_ps(normalX, _mm_loadu_ps(poly1.x + half)),
+                                   _mm_mul_ps(normalY, _mm_loadu_ps(poly1.y + half)));
+
+        __m128 separation = _mm_set1_ps(FLT_MAX);
+        for (int j = 0; j < poly2.count; ++j)
+        {
+            __m128 projection = _mm_add_ps(_mm_mul_ps(normalX, _mm_set1_ps(poly2.x[j])),
+                                           _mm_mul_ps(normalY, _mm_set1_ps(poly2.y[j])));
+            separation = _mm_min_ps(separation, projection);
+        }
+
+        _mm_storeu_ps(separations + half, _mm_sub_ps(separation, offset));
+    }
+}
+
+// All eight axes in one register
+SM_TARGET_AVX static void SeparationsAVX(float* separations, const PolygonSoA& poly1,
+                                         const PolygonSoA& poly2)
+{
+    __m256 normalX = _mm256_loadu_ps(poly1.normalX);
+    __m256 normalY = _mm256_loadu_ps(poly1.normalY);
+    __m256 offset = _mm256_add_ps(_mm256_mul_ps(normalX, _mm256_loadu_ps(poly1.x)),
+                                  _mm256_mul_ps(normalY, _mm256_loadu_ps(poly1.y)));
+
+    __m256 separation = _mm256_set1_ps(FLT_MAX);
+    for (int j = 0; j < poly2.count; ++j)
+    {
+        __m256 projection = _mm256_add_ps(_mm256_mul_ps(normalX, _mm256_set1_ps(poly2.x[j])),
+                                          _mm256_mul_ps(normalY, _mm256_set1_ps(poly2.y[j])));
+        separation = _mm256_min_ps(separation, projection);
+    }
+
+    _mm256_storeu_ps(separations, _mm256_sub_ps(separation, offset));
+}
+
+static bool CPUSupportsAVX()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+
+    // The CPU has to support AVX and the OS has to save the wide registers on context switches
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    // The kernel gets picked while statics are initialized, libgcc may not have filled in the CPU
+    // features yet
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif // SM_SIMD_X86
+
+static SeparationKernel GetSeparationKernel(SATKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef SM_SIMD_X86
+    case sm2d_SATAVX:
+        return SeparationsAVX;
+    case sm2d_SATSSE:
+        return SeparationsSSE;
+#endif
+    default:
+        return SeparationsScalar;
+    }
+}
+
+static SATKernel        currentKernel = GetBestSATKernel();
+static SeparationKernel separationKernel = GetSeparationKernel(currentKernel);
+
+void BuildPolygonSoA(PolygonSoA& soa, const glm::vec2* points, int count)
+{
+    assert(count >= 3 && count <= SM_MAX_POLYGON_VERTICES);
+
+    float area = 0.0f;
+    for (int i = 0; i < count; ++i) { area += CrossProduct(points[i], points[(i + 1) % count]); }
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    for (int i = 0; i < SM_MAX_POLYGON_VERTICES; ++i)
+    {
+        int       vertex = i < count ? i : 0;
+        glm::vec2 edge = points[(vertex + 1) % count] - points[vertex];
+        glm::vec2 normal = glm::normalize(glm::vec2(edge.y, -edge.x) * sign);
+
+        soa.x[i] = points[vertex].x;
+        soa.y[i] = points[vertex].y;
+        soa.normalX[i] = normal.x;
+        soa.normalY[i] = normal.y;
+    }
+
+    soa.count = count;
+}
+
+float FindMaxSeparation(int& edgeIndex, const PolygonSoA& poly1, const PolygonSoA& poly2)
+{
+    float separations[SM_MAX_POLYGON_VERTICES];
+    separationKernel(separations, poly1, poly2);
+
+    // The first edge wins ties so every kernel picks the same one
+    edgeIndex = 0;
+    for (int i = 1; i < poly1.count; ++i)
+    {
+        if (separations[i] > separations[edgeIndex])
+        {
+            edgeIndex = i;
+        }
+    }
+
+    return separations[edgeIndex];
+}
+
+SATKernel GetBestSATKernel()
+{
+#ifdef SM_SIMD_X86
+    return CPUSupportsAVX() ? sm2d_SATAVX : sm2d_SATSSE;
+#else
+    return sm2d_SATScalar;
+#endif
+}
+
+void SetSATKernel(SATKernel kernel)
+{
+    currentKernel = kernel > GetBestSATKernel() ? GetBestSATKernel() : kernel;
+    separationKernel = GetSeparationKernel(currentKernel);
+}
+
+SATKernel GetSATKernel()
+{
+    return currentKernel;
+}
+
+} // namespace sm2d
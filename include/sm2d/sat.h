@@ -0,0 +1,42 @@
+#pragma once
+
+#include <sm2d/types.h>
+
+namespace sm2d
+{
+
+// World space polygon in structure of arrays form, this is what the SAT kernels work on
+// Unused slots repeat the first vertex and normal so they never change a min or a max
+// The arrays aren't over-aligned because colliders live in ECS pools that only promise the
+// alignment of new char[], the kernels use unaligned loads instead
+struct PolygonSoA
+{
+    float x[SM_MAX_POLYGON_VERTICES];
+    float y[SM_MAX_POLYGON_VERTICES];
+    float normalX[SM_MAX_POLYGON_VERTICES]; // Outward normal of the edge i -> i + 1
+    float normalY[SM_MAX_POLYGON_VERTICES];
+    int   count = 0;
+};
+
+enum SATKernel
+{
+    sm2d_SATScalar = 0,
+    sm2d_SATSSE = 1,
+    sm2d_SATAVX = 2
+};
+
+// Fills in a polygon's SoA form from its points, the normals point outwards for either winding
+void BuildPolygonSoA(PolygonSoA& soa, const glm::vec2* points, int count);
+
+// Finds the edge of polygon 1 that the points of polygon 2 are furthest outside of, the largest
+// separation is negative if the polygons overlap along every edge normal of polygon 1
+float FindMaxSeparation(int& edgeIndex, const PolygonSoA& poly1, const PolygonSoA& poly2);
+
+// Returns the fastest kernel this CPU can run, it's the one that gets used by default
+SATKernel GetBestSATKernel();
+
+// Forces FindMaxSeparation onto a kernel, asking for one the CPU can't run picks the best one
+void      SetSATKernel(SATKernel kernel);
+SATKernel GetSATKernel();
+
+} // namespace sm2d
@@ -0,0 +1,14 @@
+#pragma once
+
+// Platform checks for the SIMD code paths in sm2d, everything has a scalar fallback
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SM_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SM_TARGET_AVX
+#else
+#define SM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
@@ -0,0 +1,491 @@
+#include <sm2d/solver.h>
+#include <sm2d/functions.h>
+#include <sm2d/thread_pool.h>
+#include <sm2d/world.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace sm2d
+{
+
+static uint64_t MakePairKey(int bodyA, int bodyB)
+{
+    return ((uint64_t)(uint32_t)bodyA << 32) | (uint32_t)bodyB;
+}
+
+static glm::vec2 RotateVector(const glm::vec2& v, float angle)
+{
+    float cosine = std::cos(angle);
+    float sine = std::sin(angle);
+    return glm::vec2(cosine * v.x - sine * v.y, sine * v.x + cosine * v.y);
+}
+
+// Velocity of a point on a body, w x r + v
+static glm::vec2 PointVelocity(const glm::vec2& linearVelocity, float angularVelocity,
+                               const glm::vec2& anchor)
+{
+    return linearVelocity + glm::vec2(-angularVelocity * anchor.y, angularVelocity * anchor.x);
+}
+
+Softness MakeSoftness(float hertz, float dampingRatio, float timeStep)
+{
+    if (hertz == 0.0f)
+        return {0.0f, 1.0f, 0.0f};
+
+    float omega = 2.0f * SM_PI * hertz;
+    float a1 = 2.0f * dampingRatio + timeStep * omega;
+    float a2 = timeStep * omega * a1;
+    float a3 = 1.0f / (1.0f + a2);
+    return {omega / a1, a2 * a3, a3};
+}
+
+static void PrepareContacts(World& world)
+{
+    std::unordered_map<uint64_t, CachedImpulses>& impulseCache = world.solver.impulseCache;
+    std::vector<ContactConstraint>&               constraints = world.solver.unsortedConstraints;
+    constraints.clear();
+
+    for (const Manifold& manifold : world.contacts)
+    {
+        Rigidbody* bodyA = manifold.objectA->body;
+        Rigidbody* bodyB = manifold.objectB->body;
+        assert(bodyA->bodyIndex != -1 && bodyB->bodyIndex != -1);
+
+        ContactConstraint constraint;
+        constraint.bodyA = bodyA->bodyIndex;
+        constraint.bodyB = bodyB->bodyIndex;
+
+        bool dynamicA = bodyA->type == sm2d_Dynamic;
+        bool dynamicB = bodyB->type == sm2d_Dynamic;
+        constraint.inverseMassA = dynamicA && bodyA->mass > 0.0f ? 1.0f / bodyA->mass : 0.0f;
+        constraint.inverseMassB = dynamicB && bodyB->mass > 0.0f ? 1.0f / bodyB->mass : 0.0f;
+        constraint.inverseInertiaA =
+            dynamicA && !bodyA->fixedRotation && bodyA->momentOfInertia > 0.0f
+                ? 1.0f / bodyA->momentOfInertia
+                : 0.0f;
+        constraint.inverseInertiaB =
+            dynamicB && !bodyB->fixedRotation && bodyB->momentOfInertia > 0.0f
+                ? 1.0f / bodyB->momentOfInertia
+                : 0.0f;
+
+        constraint.normal = manifold.collisionNormal;
+        constraint.friction = world.settings.friction;
+        constraint.restitution = std::min(bodyA->restitution, bodyB->restitution);
+        constraint.touchesStatic = bodyA->type == sm2d_Static || bodyB->type == sm2d_Static;
+        constraint.pointCount = manifold.pointCount;
+
+        glm::vec2 centerA = glm::vec2(bodyA->transform->position);
+        glm::vec2 centerB = glm::vec2(bodyB->transform->position);
+        glm::vec2 normal = constraint.normal;
+        glm::vec2 tangent = glm::vec2(normal.y, -normal.x);
+
+        for (int i = 0; i < manifold.pointCount; ++i)
+        {
+            ContactConstraintPoint& point = constraint.points[i];
+
+            glm::vec2 rA = manifold.points[i].point - centerA;
+            glm::vec2 rB = manifold.points[i].point - centerB;
+            point.anchorA = rA;
+            point.anchorB = rB;
+            point.baseSeparation = manifold.points[i].separation - glm::dot(rB - rA, normal);
+
+            float rnA = CrossProduct(rA, normal);
+            float rnB = CrossProduct(rB, normal);
+            float kNormal = constraint.inverseMassA + constraint.inverseMassB +
+                            constraint.inverseInertiaA * rnA * rnA +
+                            constraint.inverseInertiaB * rnB * rnB;
+            point.normalMass = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+
+            float rtA = CrossProduct(rA, tangent);
+            float rtB = CrossProduct(rB, tangent);
+            float kTangent = constraint.inverseMassA + constraint.inverseMassB +
+                             constraint.inverseInertiaA * rtA * rtA +
+                             constraint.inverseInertiaB * rtB * rtB;
+            point.tangentMass = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+
+            glm::vec2 relativeVelocity =
+                PointVelocity(bodyB->linearVelocity, bodyB->angularVelocity, rB) -
+                PointVelocity(bodyA->linearVelocity, bodyA->angularVelocity, rA);
+            point.relativeVelocity = glm::dot(relativeVelocity, normal);
+
+            point.normalImpulse = 0.0f;
+            point.tangentImpulse = 0.0f;
+            point.maxNormalImpulse = 0.0f;
+            point.id = manifold.points[i].id;
+        }
+
+        // Points made by the same features as last step start with the impulses they had, so a
+        // resting stack doesn't have to build up its support from nothing every step
+        if (world.settings.warmStarting)
+        {
+            auto cached = impulseCache.find(MakePairKey(constraint.bodyA, constraint.bodyB));
+            if (cached != impulseCache.end())
+            {
+                for (int i = 0; i < constraint.pointCount; ++i)
+                {
+                    ContactConstraintPoint& point = constraint.points[i];
+                    for (int j = 0; j < cached->second.pointCount; ++j)
+                    {
+                        if (cached->second.ids[j] == point.id)
+                        {
+                            point.normalImpulse = cached->second.normalImpulses[j];
+                            point.tangentImpulse = cached->second.tangentImpulses[j];
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        constraints.push_back(constraint);
+    }
+}
+
+static void StoreImpulses(SolverState& solver)
+{
+    std::unordered_map<uint64_t, CachedImpulses>& impulseCache = solver.impulseCache;
+    impulseCache.clear();
+
+    for (const ContactConstraint& constraint : solver.contactConstraints)
+    {
+        CachedImpulses& cached = impulseCache[MakePairKey(constraint.bodyA, constraint.bodyB)];
+        cached.pointCount = constraint.pointCount;
+
+        for (int i = 0; i < constraint.pointCount; ++i)
+        {
+            cached.ids[i] = constraint.points[i].id;
+            cached.normalImpulses[i] = constraint.points[i].normalImpulse;
+            cached.tangentImpulses[i] = constraint.points[i].tangentImpulse;
+        }
+    }
+}
+
+// Static and kinematic bodies are only read by the solver, so any number of constraints in a color
+// can share them
+static bool MovesBodyA(const ContactConstraint& constraint)
+{
+    return constraint.inverseMassA != 0.0f || constraint.inverseInertiaA != 0.0f;
+}
+
+static bool MovesBodyB(const ContactConstraint& constraint)
+{
+    return constraint.inverseMassB != 0.0f || constraint.inverseInertiaB != 0.0f;
+}
+
+static bool TestBit(const std::vector<uint64_t>& set, int index)
+{
+    return (set[index >> 6] >> (index & 63)) & 1;
+}
+
+static void SetBit(std::vector<uint64_t>& set, int index)
+{
+    set[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+// Greedily gives every constraint the first color that none of its moving bodies are in yet, then
+// sorts the constraints by color. Both passes go in the order of the collision results, so the
+// coloring is the same every time for the same contacts
+static void ColorContacts(SolverState& solver, int bodyCount)
+{
+    const std::vector<ContactConstraint>& constraints = solver.unsortedConstraints;
+    std::vector<ContactConstraint>&       contactConstraints = solver.contactConstraints;
+    std::vector<int>&                     constraintColors = solver.constraintColors;
+    int*                                  colorOffsets = solver.colorOffsets;
+
+    int wordCount = (bodyCount + 63) / 64;
+    for (std::vector<uint64_t>& set : solver.colorBodySets)
+    {
+        set.assign(wordCount, 0);
+    }
+
+    int colorCounts[SM_GRAPH_COLOR_COUNT + 1] = {};
+    constraintColors.resize(constraints.size());
+
+    for (int i = 0; i < (int)constraints.size(); ++i)
+    {
+        const ContactConstraint& constraint = constraints[i];
+        bool                     movesA = MovesBodyA(constraint);
+        bool                     movesB = MovesBodyB(constraint);
+
+        int color = SM_GRAPH_COLOR_COUNT;
+        for (int j = 0; j < SM_GRAPH_COLOR_COUNT; ++j)
+        {
+            std::vector<uint64_t>& set = solver.colorBodySets[j];
+            if ((movesA && TestBit(set, constraint.bodyA)) ||
+                (movesB && TestBit(set, constraint.bodyB)))
+            {
+                continue;
+            }
+
+            if (movesA)
+                SetBit(set, constraint.bodyA);
+            if (movesB)
+                SetBit(set, constraint.bodyB);
+
+            color = j;
+            break;
+        }
+
+        constraintColors[i] = color;
+        ++colorCounts[color];
+    }
+
+    colorOffsets[0] = 0;
+    for (int i = 0; i <= SM_GRAPH_COLOR_COUNT; ++i)
+    {
+        colorOffsets[i + 1] = colorOffsets[i] + colorCounts[i];
+    }
+
+    int next[SM_GRAPH_COLOR_COUNT + 1];
+    std::copy(colorOffsets, colorOffsets + SM_GRAPH_COLOR_COUNT + 1, next);
+
+    contactConstraints.resize(constraints.size());
+    for (int i = 0; i < (int)constraints.size(); ++i)
+    {
+        contactConstraints[next[constraintColors[i]]++] = constraints[i];
+    }
+}
+
+// Runs task on every constraint, the colors one after another with each color spread over the
+// thread pool, and then the overflow on this thread
+template<typename Task>
+static void ForEachContact(SolverState& solver, Task task)
+{
+    ThreadPool&                     pool = GetThreadPool();
+    std::vector<ContactConstraint>& contactConstraints = solver.contactConstraints;
+    const int*                      colorOffsets = solver.colorOffsets;
+
+    for (int color = 0; color < SM_GRAPH_COLOR_COUNT; ++color)
+    {
+        int begin = colorOffsets[color];
+        int count = colorOffsets[color + 1] - begin;
+
+        pool.ParallelFor(count, SM_SOLVER_MIN_BATCH, [&](int rangeBegin, int rangeEnd, int)
+        {
+            for (int i = begin + rangeBegin; i < begin + rangeEnd; ++i)
+            {
+                task(contactConstraints[i]);
+            }
+        });
+    }
+
+    for (int i = colorOffsets[SM_GRAPH_COLOR_COUNT]; i < colorOffsets[SM_GRAPH_COLOR_COUNT + 1];
+         ++i)
+    {
+        task(contactConstraints[i]);
+    }
+}
+
+// Applies an impulse at the anchors, -impulse to body A and +impulse to body B
+// Bodies the solver doesn't move are never written, other threads may be reading them
+static void ApplyContactImpulse(BodyStorage& storage, const ContactConstraint& constraint,
+                                const glm::vec2& anchorA, const glm::vec2& anchorB,
+                                const glm::vec2& impulse)
+{
+    int a = constraint.bodyA;
+    int b = constraint.bodyB;
+
+    if (MovesBodyA(constraint))
+    {
+        storage.linearVelocityX[a] -= constraint.inverseMassA * impulse.x;
+        storage.linearVelocityY[a] -= constraint.inverseMassA * impulse.y;
+        storage.angularVelocity[a] -= constraint.inverseInertiaA * CrossProduct(anchorA, impulse);
+    }
+
+    if (MovesBodyB(constraint))
+    {
+        storage.linearVelocityX[b] += constraint.inverseMassB * impulse.x;
+        storage.linearVelocityY[b] += constraint.inverseMassB * impulse.y;
+        storage.angularVelocity[b] += constraint.inverseInertiaB * CrossProduct(anchorB, impulse);
+    }
+}
+
+static glm::vec2 RelativeVelocity(const BodyStorage& storage, const ContactConstraint& constraint,
+                                  const ContactConstraintPoint& point)
+{
+    int a = constraint.bodyA;
+    int b = constraint.bodyB;
+
+    glm::vec2 velocityA = glm::vec2(storage.linearVelocityX[a], storage.linearVelocityY[a]);
+    glm::vec2 velocityB = glm::vec2(storage.linearVelocityX[b], storage.linearVelocityY[b]);
+
+    return PointVelocity(velocityB, storage.angularVelocity[b], point.anchorB) -
+           PointVelocity(velocityA, storage.angularVelocity[a], point.anchorA);
+}
+
+static void WarmStartContact(BodyStorage& storage, const ContactConstraint& constraint)
+{
+    glm::vec2 tangent = glm::vec2(constraint.normal.y, -constraint.normal.x);
+
+    for (int i = 0; i < constraint.pointCount; ++i)
+    {
+        const ContactConstraintPoint& point = constraint.points[i];
+        glm::vec2 impulse =
+            point.normalImpulse * constraint.normal + point.tangentImpulse * tangent;
+        ApplyContactImpulse(storage, constraint, point.anchorA, point.anchorB, impulse);
+    }
+}
+
+static void SolveContact(BodyStorage& storage, ContactConstraint& constraint,
+                         const Softness& softness, float inverseSubstep, float pushVelocity,
+                         bool useBias)
+{
+    int a = constraint.bodyA;
+    int b = constraint.bodyB;
+
+    glm::vec2 normal = constraint.normal;
+    glm::vec2 tangent = glm::vec2(normal.y, -normal.x);
+    glm::vec2 deltaPositionA = glm::vec2(storage.deltaPositionX[a], storage.deltaPositionY[a]);
+    glm::vec2 deltaPositionB = glm::vec2(storage.deltaPositionX[b], storage.deltaPositionY[b]);
+
+    for (int i = 0; i < constraint.pointCount; ++i)
+    {
+        ContactConstraintPoint& point = constraint.points[i];
+
+        // The current separation is rebuilt from how far the bodies moved since the narrowphase
+        glm::vec2 movedA = RotateVector(point.anchorA, storage.deltaRotation[a]);
+        glm::vec2 movedB = RotateVector(point.anchorB, storage.deltaRotation[b]);
+        glm::vec2 d = deltaPositionB - deltaPositionA + movedB - movedA;
+        float     separation = glm::dot(d, normal) + point.baseSeparation;
+
+        float bias = 0.0f;
+        float massScale = 1.0f;
+        float impulseScale = 0.0f;
+        if (separation > 0.0f)
+        {
+            // Speculative, only stop the bodies from closing the gap within this substep
+            bias = separation * inverseSubstep;
+        }
+        else if (useBias)
+        {
+            bias = std::max(softness.biasRate * separation, -pushVelocity);
+            massScale = softness.massScale;
+            impulseScale = softness.impulseScale;
+        }
+
+        float normalVelocity = glm::dot(RelativeVelocity(storage, constraint, point), normal);
+        float impulse = -point.normalMass * massScale * (normalVelocity + bias) -
+                        impulseScale * point.normalImpulse;
+
+        float newImpulse = std::max(point.normalImpulse + impulse, 0.0f);
+        impulse = newImpulse - point.normalImpulse;
+        point.normalImpulse = newImpulse;
+        point.maxNormalImpulse = std::max(point.maxNormalImpulse, impulse);
+
+        ApplyContactImpulse(storage, constraint, point.anchorA, point.anchorB, impulse * normal);
+    }
+
+    for (int i = 0; i < constraint.pointCount; ++i)
+    {
+        ContactConstraintPoint& point = constraint.points[i];
+
+        float tangentVelocity = glm::dot(RelativeVelocity(storage, constraint, point), tangent);
+        float impulse = -point.tangentMass * tangentVelocity;
+
+        float maxFriction = constraint.friction * point.normalImpulse;
+        float newImpulse = std::clamp(point.tangentImpulse + impulse, -maxFriction, maxFriction);
+        impulse = newImpulse - point.tangentImpulse;
+        point.tangentImpulse = newImpulse;
+
+        ApplyContactImpulse(storage, constraint, point.anchorA, point.anchorB, impulse * tangent);
+    }
+}
+
+static void ApplyRestitution(BodyStorage& storage, ContactConstraint& constraint, float threshold)
+{
+    if (constraint.restitution == 0.0f)
+        return;
+
+    for (int i = 0; i < constraint.pointCount; ++i)
+    {
+        ContactConstraintPoint& point = constraint.points[i];
+
+        // Only bounce off contacts that were closing fast and actually pushed on the bodies
+        if (point.relativeVelocity > -threshold || point.maxNormalImpulse == 0.0f)
+            continue;
+
+        float normalVelocity =
+            glm::dot(RelativeVelocity(storage, constraint, point), constraint.normal);
+        float impulse = -point.normalMass *
+                        (normalVelocity + constraint.restitution * point.relativeVelocity);
+
+        float newImpulse = std::max(point.normalImpulse + impulse, 0.0f);
+        impulse = newImpulse - point.normalImpulse;
+        point.normalImpulse = newImpulse;
+
+        ApplyContactImpulse(storage, constraint, point.anchorA, point.anchorB,
+                            impulse * constraint.normal);
+    }
+}
+
+void SolveContacts(World& world, float deltaTime)
+{
+    if (world.settings.solverType == sm2d_SolverSoftStep)
+    {
+        SolveSoftStep(world, deltaTime);
+    }
+    else
+    {
+        ResolveCollisions(world.contacts);
+    }
+}
+
+void SolveSoftStep(World& world, float deltaTime)
+{
+    const WorldSettings& settings = world.settings;
+    BodyStorage&         storage = world.bodies;
+
+    int   substepCount = std::max(settings.substepCount, 1);
+    float substep = deltaTime / (float)substepCount;
+    if (substep <= 0.0f)
+        return;
+
+    float inverseSubstep = 1.0f / substep;
+
+    // Stiffer than a quarter of the substep rate and the springs stop being stable
+    float contactHertz = std::min(settings.contactHertz, 0.25f * inverseSubstep);
+    Softness contactSoftness = MakeSoftness(contactHertz, settings.contactDampingRatio, substep);
+    Softness staticSoftness =
+        MakeSoftness(2.0f * contactHertz, settings.contactDampingRatio, substep);
+
+    LoadBodies(world, substep);
+    PrepareContacts(world);
+    ColorContacts(world.solver, (int)storage.bodies.size());
+
+    auto warmStart = [&](ContactConstraint& constraint) { WarmStartContact(storage, constraint); };
+
+    auto solve = [&](ContactConstraint& constraint)
+    {
+        SolveContact(storage, constraint,
+                     constraint.touchesStatic ? staticSoftness : contactSoftness, inverseSubstep,
+                     settings.contactPushVelocity, true);
+    };
+
+    // Relax, take out the velocity the soft position correction added
+    auto relax = [&](ContactConstraint& constraint)
+    {
+        SolveContact(storage, constraint,
+                     constraint.touchesStatic ? staticSoftness : contactSoftness, inverseSubstep,
+                     settings.contactPushVelocity, false);
+    };
+
+    auto restitution = [&](ContactConstraint& constraint)
+    { ApplyRestitution(storage, constraint, settings.restitutionThreshold); };
+
+    for (int i = 0; i < substepCount; ++i)
+    {
+        IntegrateVelocities(world);
+        ForEachContact(world.solver, warmStart);
+        ForEachContact(world.solver, solve);
+        IntegratePositions(world);
+        ForEachContact(world.solver, relax);
+    }
+
+    ForEachContact(world.solver, restitution);
+
+    StoreImpulses(world.solver);
+    StoreBodies(world);
+}
+
+} // namespace sm2d
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <unordered_map>
+#include <vector>
+
+#define SM_GRAPH_COLOR_COUNT (12) // Colors the contacts are split into, the rest go in the overflow
+#define SM_SOLVER_MIN_BATCH (64)  // Fewest constraints of a color a worker gets before threading
+
+namespace sm2d
+{
+
+struct World;
+
+// A contact point prepared for the soft step solver
+struct ContactConstraintPoint
+{
+    glm::vec2 anchorA;          // Contact point relative to the center of body A
+    glm::vec2 anchorB;          // Contact point relative to the center of body B
+    float     baseSeparation;   // Separation with the anchors taken out, the solver adds back
+                                // how far the bodies moved to get the current separation
+    float     relativeVelocity; // Normal velocity before solving, used for restitution
+    float     normalMass;
+    float     tangentMass;
+    float     normalImpulse;    // Accumulated over the substeps of a step
+    float     tangentImpulse;
+    float     maxNormalImpulse; // Largest impulse applied in a substep, restitution needs it
+    uint32_t  id;               // Feature id of the manifold point, matches it to the last step
+};
+
+struct ContactConstraint
+{
+    int       bodyA; // Slot of body A in the world's body storage
+    int       bodyB; // Slot of body B in the world's body storage
+    float     inverseMassA;
+    float     inverseInertiaA;
+    float     inverseMassB;
+    float     inverseInertiaB;
+    glm::vec2 normal; // Points from A to B
+    float     friction;
+    float     restitution;
+    bool      touchesStatic; // Contacts against static bodies are made stiffer
+
+    ContactConstraintPoint points[SM_MAX_MANIFOLD_POINTS];
+    int                    pointCount;
+};
+
+// Impulses the points of a contact ended the last step with
+struct CachedImpulses
+{
+    uint32_t ids[SM_MAX_MANIFOLD_POINTS];
+    float    normalImpulses[SM_MAX_MANIFOLD_POINTS];
+    float    tangentImpulses[SM_MAX_MANIFOLD_POINTS];
+    int      pointCount;
+};
+
+// What the soft step solver keeps between steps, every world has its own
+struct SolverState
+{
+    // Contact constraints of the current step sorted by color, kept so their memory gets reused
+    std::vector<ContactConstraint> contactConstraints;
+    std::vector<ContactConstraint> unsortedConstraints;
+
+    // Color i covers [colorOffsets[i], colorOffsets[i + 1]), the last range is the overflow
+    int colorOffsets[SM_GRAPH_COLOR_COUNT + 2] = {};
+
+    // One bit per body slot for each color, set when a constraint of the color moves that body
+    std::vector<uint64_t> colorBodySets[SM_GRAPH_COLOR_COUNT];
+    std::vector<int>      constraintColors;
+
+    // Keyed by the body slots of the pair, in the order the manifold had them
+    std::unordered_map<uint64_t, CachedImpulses> impulseCache;
+};
+
+// Coefficients that turn a rigid constraint into a damped spring
+struct Softness
+{
+    float biasRate;
+    float massScale;
+    float impulseScale;
+};
+
+// Computes the softness of a spring with the given frequency and damping ratio over a time step
+Softness MakeSoftness(float hertz, float dampingRatio, float timeStep);
+
+// Runs the solver picked in the world's settings on the world's contacts
+void SolveContacts(World& world, float deltaTime);
+
+// Substepped soft contact solver in the style of Box2D v3, it integrates the bodies itself so
+// RigidbodySys leaves them alone in this mode. Each substep integrates velocities, warm starts,
+// solves with soft position correction, integrates positions and then relaxes the contacts
+// without it. Restitution is applied once at the end
+// The constraints are colored so that no two constraints of a color share a body the solver moves,
+// each color is solved in parallel and whatever didn't fit in a color is solved serially after.
+// Constraints of a color never touch the same body, so the result doesn't depend on the threads
+void SolveSoftStep(World& world, float deltaTime);
+
+} // namespace sm2d
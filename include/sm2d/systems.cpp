@@ -5,6 +5,8 @@
 #include <salmon/ecs.h>
 #include <salmon/engine.h>
 #include <sm2d/functions.h>
+#include <sm2d/continuous.h>
+#include <sm2d/world.h>
 #include <glm/gtx/string_cast.hpp>
 #include <salmon/clock.h>
 
@@ -13,38 +15,24 @@ namespace sm2d
 
 void RigidbodySys()
 {
+    // New bodies get a slot in the body storage the first time they're seen
     for (EntityID ent : SceneView<Rigidbody>(engineState.scene))
     {
         auto rigid = engineState.scene.Get<Rigidbody>(ent);
 
-        if (rigid->type == sm2d_Static || !rigid->awake)
+        if (rigid->bodyIndex == -1)
         {
-            continue;
+            AddBody(world, rigid);
         }
+    }
 
-        rigid->force.y += -3.5f * rigid->mass; // GRAVITAS
-
-        rigid->linearVelocity += rigid->force / rigid->mass * engineState.deltaTime;
-        rigid->linearVelocity *= glm::pow(rigid->linearDamping, engineState.deltaTime);
-        rigid->transform->position.x += rigid->linearVelocity.x * engineState.deltaTime;
-        rigid->transform->position.y += rigid->linearVelocity.y * engineState.deltaTime;
-
-        rigid->angularVelocity += rigid->torque / rigid->mass * engineState.deltaTime;
-        rigid->angularVelocity *= glm::pow(rigid->angularDamping, engineState.deltaTime);
-        rigid->transform->rotation.z += rigid->angularVelocity * engineState.deltaTime;
+    // The soft step solver integrates the bodies itself between its substeps
+    if (world.settings.solverType == sm2d_SolverSoftStep)
+        return;
 
-        if (rigid->angularVelocity > 0.05f || glm::length(rigid->linearVelocity) > 0.01f)
-        {
-            rigid->hasMoved = true;
-        }
-        else
-        {
-            rigid->hasMoved = false;
-        }
-
-        rigid->force = glm::vec2(0.0f);
-        rigid->torque = 0.0f;
-    }
+    LoadBodies(world, engineState.deltaTime);
+    IntegrateBodies(world);
+    StoreBodies(world);
 }
 
 void DebugSys()
@@ -94,6 +82,17 @@ void DebugSys()
                 engineState.camera->GetProjMatrix(engineState.window->GetAspectRatio()),
                 engineState.camera->GetViewMatrix());
         }
+        else if (collider->type == ColliderType::sm2d_Chain)
+        {
+            for (Collider* segment : collider->chain.segments)
+            {
+                Renderer::RenderLine(
+                    {glm::vec3(segment->segment.worldPoint1, 0.0f),
+                     glm::vec3(segment->segment.worldPoint2, 0.0f)},
+                    engineState.camera->GetProjMatrix(engineState.window->GetAspectRatio()),
+                    engineState.camera->GetViewMatrix());
+            }
+        }
     }
 }
 
@@ -101,61 +100,18 @@ void ColliderStartSys()
 {
     for (EntityID ent : SceneView<Collider>(engineState.scene))
     {
-        auto collider = engineState.scene.Get<Collider>(ent);
-
-        if (collider->type == ColliderType::sm2d_AABB)
-        {
-            InsertLeaf(bvh, collider, ColAABBToABBB(*collider));
-        }
-        else if (collider->type == ColliderType::sm2d_Circle)
-        {
-            InsertLeaf(bvh, collider, ColCircleToABBB(*collider));
-        }
-        else if (collider->type == ColliderType::sm2d_Polygon)
-        {
-            for (int i = 0; i < collider->polygon.points.size(); ++i)
-            {
-                collider->polygon.worldPoints.push_back(glm::vec2(0.0f, 0.0f));
-            }
-            UpdatePolygon(*collider);
-            collider->polygon.center = ComputePolygonCenter(collider->polygon);
-            InsertLeaf(bvh, collider, ColPolygonToAABB(*collider));
-        }
+        AddCollider(world, engineState.scene.Get<Collider>(ent));
     }
 }
 
 void ColliderSys()
 {
-    for (EntityID ent : SceneView<Collider>(engineState.scene))
-    {
-        auto collider = engineState.scene.Get<Collider>(ent);
-
-        if (collider->body->type == BodyType::sm2d_Static || !collider->body->awake)
-        {
-            continue;
-        }
+    UpdateColliders(world);
+}
 
-        if (collider->type == ColliderType::sm2d_AABB)
-        {
-            RemoveLeaf(bvh, collider->treeIndex);
-            RemoveDeletedLeaves(bvh);
-            InsertLeaf(bvh, collider, ColAABBToABBB(*collider));
-        }
-        else if (collider->type == ColliderType::sm2d_Circle)
-        {
-            RemoveLeaf(bvh, collider->treeIndex);
-            RemoveDeletedLeaves(bvh);
-            InsertLeaf(bvh, collider, ColCircleToABBB(*collider));
-        }
-        else if (collider->type == ColliderType::sm2d_Polygon)
-        {
-            UpdatePolygon(*collider);
-            collider->polygon.center = ComputePolygonCenter(collider->polygon);
-            RemoveLeaf(bvh, collider->treeIndex);
-            RemoveDeletedLeaves(bvh);
-            InsertLeaf(bvh, collider, ColPolygonToAABB(*collider));
-        }
-    }
+void ContinuousSys()
+{
+    SolveBullets(world);
 }
 
 REGISTER_START_SYSTEM(ColliderStartSys);
@@ -163,5 +119,6 @@ REGISTER_START_SYSTEM(ColliderStartSys);
 // REGISTER_SYSTEM(DebugSys);
 REGISTER_SYSTEM(RigidbodySys);
 REGISTER_SYSTEM(ColliderSys);
+REGISTER_SYSTEM(ContinuousSys);
 
 } // namespace sm2d
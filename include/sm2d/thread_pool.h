@@ -0,0 +1,19 @@
+#pragma once
+
+#include <salmon/job_system.h>
+
+namespace sm2d
+{
+
+// The parallel parts of sm2d run on the engine job system, so they share its workers with Jolt and
+// the other engine systems. Work is handed out in contiguous ranges so that results can be merged
+// in a fixed order
+using ThreadPool = EngineJobSystem;
+
+// Returns the pool that sm2d spreads its work over
+inline ThreadPool& GetThreadPool()
+{
+    return GetJobSystem();
+}
+
+} // namespace sm2d
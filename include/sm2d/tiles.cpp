@@ -0,0 +1,173 @@
+#include <sm2d/tiles.h>
+
+namespace sm2d
+{
+
+static bool IsSolid(const TileGrid& grid, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= grid.width || y >= grid.height)
+        return false;
+
+    return grid.solid[x + y * grid.width] != 0;
+}
+
+// An edge between a solid and an empty tile going from one grid corner to the next, with the
+// solid tile on its left
+struct TileEdge
+{
+    int start; // Corner index, x + y * (width + 1)
+    int end;
+    int directionX;
+    int directionY;
+    int nextOut = -1; // Next edge that starts at the same corner
+};
+
+void MergeTilesIntoChains(const TileGrid& grid, std::vector<std::vector<glm::vec2>>& chains)
+{
+    int cornerStride = grid.width + 1;
+    int cornerCount = cornerStride * (grid.height + 1);
+
+    std::vector<TileEdge> edges;
+    std::vector<int>      firstOut(cornerCount, -1);
+
+    auto addEdge = [&](int x0, int y0, int x1, int y1)
+    {
+        TileEdge edge;
+        edge.start = x0 + y0 * cornerStride;
+        edge.end = x1 + y1 * cornerStride;
+        edge.directionX = x1 - x0;
+        edge.directionY = y1 - y0;
+        edge.nextOut = firstOut[edge.start];
+        firstOut[edge.start] = (int)edges.size();
+        edges.push_back(edge);
+    };
+
+    for (int y = 0; y < grid.height; ++y)
+    {
+        for (int x = 0; x < grid.width; ++x)
+        {
+            if (!IsSolid(grid, x, y))
+                continue;
+
+            if (!IsSolid(grid, x, y - 1))
+                addEdge(x, y, x + 1, y);
+            if (!IsSolid(grid, x + 1, y))
+                addEdge(x + 1, y, x + 1, y + 1);
+            if (!IsSolid(grid, x, y + 1))
+                addEdge(x + 1, y + 1, x, y + 1);
+            if (!IsSolid(grid, x - 1, y))
+                addEdge(x, y + 1, x, y);
+        }
+    }
+
+    std::vector<bool>       visited(edges.size(), false);
+    std::vector<glm::ivec2> corners;
+
+    for (int firstEdge = 0; firstEdge < (int)edges.size(); ++firstEdge)
+    {
+        if (visited[firstEdge])
+            continue;
+
+        corners.clear();
+
+        int edgeIndex = firstEdge;
+        while (true)
+        {
+            const TileEdge& edge = edges[edgeIndex];
+            visited[edgeIndex] = true;
+            corners.push_back(glm::ivec2(edge.start % cornerStride, edge.start / cornerStride));
+
+            // A corner where two tiles only touch diagonally has two ways out, turning left stays
+            // on the tile the loop came from
+            int next = -1;
+            for (int out = firstOut[edge.end]; out != -1; out = edges[out].nextOut)
+            {
+                if (visited[out] && out != firstEdge)
+                    continue;
+
+                bool turnsLeft = edges[out].directionX == -edge.directionY &&
+                                 edges[out].directionY == edge.directionX;
+                if (next == -1 || turnsLeft)
+                {
+                    next = out;
+                }
+            }
+
+            if (next == -1 || next == firstEdge)
+                break;
+
+            edgeIndex = next;
+        }
+
+        // Drop the corners in the middle of straight runs
+        std::vector<glm::vec2>& chain = chains.emplace_back();
+        int                     count = (int)corners.size();
+        for (int i = 0; i < count; ++i)
+        {
+            glm::ivec2 previous = corners[(i + count - 1) % count];
+            glm::ivec2 corner = corners[i];
+            glm::ivec2 next = corners[(i + 1) % count];
+
+            glm::ivec2 in = corner - previous;
+            glm::ivec2 out = next - corner;
+            if (in.x * out.y - in.y * out.x == 0)
+                continue;
+
+            chain.push_back(grid.origin + grid.tileSize * glm::vec2(corner));
+        }
+    }
+}
+
+void MergeTilesIntoRectangles(const TileGrid& grid, std::vector<AABB>& rectangles)
+{
+    std::vector<bool> covered(grid.width * grid.height, false);
+
+    auto isFree = [&](int x, int y)
+    {
+        return IsSolid(grid, x, y) && !covered[x + y * grid.width];
+    };
+
+    for (int y = 0; y < grid.height; ++y)
+    {
+        for (int x = 0; x < grid.width; ++x)
+        {
+            if (!isFree(x, y))
+                continue;
+
+            int right = x;
+            while (isFree(right + 1, y))
+            {
+                ++right;
+            }
+
+            int top = y;
+            while (true)
+            {
+                bool rowFree = true;
+                for (int column = x; column <= right && rowFree; ++column)
+                {
+                    rowFree = isFree(column, top + 1);
+                }
+
+                if (!rowFree)
+                    break;
+
+                ++top;
+            }
+
+            for (int row = y; row <= top; ++row)
+            {
+                for (int column = x; column <= right; ++column)
+                {
+                    covered[column + row * grid.width] = true;
+                }
+            }
+
+            rectangles.push_back(
+                AABB(grid.origin + grid.tileSize * glm::vec2(right + 1, top + 1),
+                     grid.origin + grid.tileSize * glm::vec2(x, y)));
+        }
+    }
+}
+
+} // namespace sm2d
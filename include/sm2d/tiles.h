@@ -0,0 +1,36 @@
+#pragma once
+
+#include <sm2d/types.h>
+#include <cstdint>
+#include <vector>
+
+namespace sm2d
+{
+
+// The solid tiles of a tile map, solid[x + y * width] is non-zero for a solid tile and row zero is
+// at the bottom. Tiles outside the grid count as empty
+struct TileGrid
+{
+    const uint8_t* solid = nullptr;
+    int            width = 0;
+    int            height = 0;
+    float          tileSize = 1.0f;
+    glm::vec2      origin = glm::vec2(0.0f); // Bottom left corner of tile (0, 0)
+};
+
+// Level loading tools that turn a tile map into a few large colliders instead of one per tile, so
+// the static tree has far fewer leaves and bodies find far fewer pairs against the level
+
+// Traces the outline of every group of touching solid tiles into a loop for a chain collider.
+// Only edges between a solid and an empty tile are kept and straight runs of them become a single
+// edge, so a flat floor is one segment however many tiles wide it is and there are no seams for
+// shapes to catch on. Loops go counter-clockwise around solid tiles and clockwise around holes,
+// which keeps the normals pointing at the empty side. Tiles that only touch at a corner get loops
+// of their own
+void MergeTilesIntoChains(const TileGrid& grid, std::vector<std::vector<glm::vec2>>& chains);
+
+// Covers the solid tiles with rectangles, each one as wide as the row allows and then as tall as
+// the rows above it allow. The rectangles don't overlap but they still have seams between them
+void MergeTilesIntoRectangles(const TileGrid& grid, std::vector<AABB>& rectangles);
+
+} // namespace sm2d
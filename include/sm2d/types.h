@@ -5,10 +5,30 @@
 
 #define SM_PI (3.14159265359f)
 
+#define SM_LINEAR_SLEEP_TOLERANCE  (0.05f) // Bodies moving slower than this are resting
+#define SM_ANGULAR_SLEEP_TOLERANCE (0.05f) // Bodies rotating slower than this are resting
+#define SM_TIME_TO_SLEEP           (0.5f)  // Seconds a whole island has to rest before it sleeps
+
+#define SM_NARROWPHASE_MIN_PAIRS (64) // Fewest pairs a narrowphase worker gets before threading
+#define SM_TREE_BUILD_BINS       (16) // Split candidates per axis when a tree is built top down
+
+#define SM_MAX_POLYGON_VERTICES (8)      // Most points a polygon collider has, see CheckPolygon
+#define SM_MAX_MANIFOLD_POINTS  (2)      // Two convex shapes touch in a point or along an edge
+#define SM_LINEAR_SLOP          (0.005f) // Distance that counts as touching, keeps contacts stable
+
+#define SM_DEFAULT_CATEGORY_BITS (0x00000001u) // Category colliders are in unless told otherwise
+#define SM_ALL_CATEGORY_BITS     (0xFFFFFFFFu) // Mask that collides with every category
+
+// Packs the features that made a contact point into an id that stays the same between frames
+#define SM_MAKE_FEATURE_ID(referenceEdge, incidentVertex, clip, flip)                              \
+    ((uint32_t)(referenceEdge) | ((uint32_t)(incidentVertex) << 8) | ((uint32_t)(clip) << 16) |   \
+     ((uint32_t)(flip) << 24))
+
 namespace sm2d
 {
 
 struct Collider;
+struct World;
 
 struct AABB
 {
@@ -29,6 +49,8 @@ enum BodyType
     sm2d_Kinematic = 2
 };
 
+// Once a body is in a world the world steps its own copy of the state, see MarkBodyDirty for
+// changing it by hand
 struct Rigidbody
 {
     BodyType type;
@@ -36,9 +58,8 @@ struct Rigidbody
     Transform* transform;
 
     float mass;
-    bool  awake; // Is the body's broadphase AABB gonna get updated or not? also skip the solver if
-                 // this is false, this is set true when hasMoved is false and the collisions have
-                 // transferred from last frame
+    bool  awake; // Sleeping bodies are skipped by the integrator, the broadphase and the
+                 // narrowphase, whole islands of touching bodies fall asleep and wake up together
 
     float linearDamping;  // Linear velocity gets exponentiated by this every frame
     float angularDamping; // Angular velocity gets exponentiated by this every frame
@@ -57,6 +78,18 @@ struct Rigidbody
     float     torque = 0.0f;           // In radians
 
     bool  hasMoved;     // If it has moved in the last frame
+
+    float     sleepTime = 0.0f;                   // How long the body has been resting
+    int       islandIndex = -1;                   // Sleeping island this body is in, -1 if awake
+    glm::vec2 previousPosition = glm::vec2(0.0f); // Position at the start of the step
+    float     previousRotation = 0.0f;            // Rotation at the start of the step
+
+    bool bullet = false; // Fast bodies that sweep their motion against static colliders every step
+                         // so they can't tunnel through them, costs a time of impact search
+
+    int    bodyIndex = -1;  // Slot in the world's body storage, -1 until it's added to a world
+    World* world = nullptr; // World the body was added to
+    bool   dirty = false;   // In its world's dirty list, see MarkBodyDirty
 };
 
 struct Node
@@ -68,14 +101,36 @@ struct Node
     int       child1;
     int       child2;
     bool      leaf;
+    uint32_t  categoryBits; // Every category in the subtree, lets queries skip whole subtrees
+    uint32_t  maskBits;     // Every mask in the subtree, lets pair generation skip subtrees
+};
+
+// Two colliders with overlapping AABBs found by the broadphase, handed to the narrowphase
+struct Pair
+{
+    Collider* colliderA;
+    Collider* colliderB;
+};
+
+// A sensor and a collider that started or stopped overlapping it
+struct SensorEvent
+{
+    Collider* sensor;
+    Collider* visitor;
 };
 
 struct Tree
 {
     std::vector<Node> nodes;
-    int               rootIndex; // Index of the root node
+    int               rootIndex = -1; // Index of the root node
+    int               freeList = -1;  // First node RemoveLeaf freed, InsertLeaf reuses them
 };
 
-inline Tree bvh;
+// A group of bodies that are touching each other, only sleeping islands are kept around between
+// frames so that they can be woken up as a unit
+struct Island
+{
+    std::vector<Rigidbody*> bodies;
+};
 
 } // namespace sm2d
@@ -0,0 +1,456 @@
+#include <sm2d/world.h>
+#include <sm2d/continuous.h>
+#include <sm2d/functions.h>
+#include <sm2d/simd.h>
+#include <sm2d/solver.h>
+#include <sm2d/thread_pool.h>
+#include <cassert>
+#include <cmath>
+
+namespace sm2d
+{
+
+void AddBody(World& world, Rigidbody* body)
+{
+    BodyStorage& storage = world.bodies;
+
+    body->bodyIndex = (int)storage.bodies.size();
+    body->world = &world;
+    storage.bodies.push_back(body);
+    storage.moving.push_back(0);
+
+    for (std::vector<float>* array :
+         {&storage.positionX, &storage.positionY, &storage.rotation, &storage.linearVelocityX,
+          &storage.linearVelocityY, &storage.angularVelocity, &storage.forceX, &storage.forceY,
+          &storage.torque, &storage.inverseMass, &storage.inverseInertia, &storage.linearDamping,
+          &storage.angularDamping, &storage.linearDampingFactor, &storage.angularDampingFactor,
+          &storage.stepTime, &storage.deltaPositionX, &storage.deltaPositionY,
+          &storage.deltaRotation, &storage.previousPositionX, &storage.previousPositionY,
+          &storage.previousRotation})
+    {
+        array->push_back(0.0f);
+    }
+
+    // Its state gets read the next time the bodies are loaded
+    body->dirty = false;
+    MarkBodyDirty(body);
+}
+
+void MarkBodyDirty(Rigidbody* body)
+{
+    // Bodies that aren't in a world yet get read when they're added
+    if (body->dirty || body->world == nullptr)
+        return;
+
+    body->dirty = true;
+    body->world->bodies.dirtyBodies.push_back(body->bodyIndex);
+}
+
+void SetBodyTransform(Rigidbody* body, const glm::vec2& position, float rotation)
+{
+    body->transform->position.x = position.x;
+    body->transform->position.y = position.y;
+    body->transform->rotation.z = rotation;
+    MarkBodyDirty(body);
+}
+
+void SetLinearVelocity(Rigidbody* body, const glm::vec2& velocity)
+{
+    body->linearVelocity = velocity;
+    MarkBodyDirty(body);
+}
+
+void SetAngularVelocity(Rigidbody* body, float velocity)
+{
+    body->angularVelocity = velocity;
+    MarkBodyDirty(body);
+}
+
+void CopyBodyToStorage(Rigidbody* body)
+{
+    if (body->world == nullptr)
+        return;
+
+    BodyStorage& storage = body->world->bodies;
+    int          i = body->bodyIndex;
+
+    storage.positionX[i] = body->transform->position.x;
+    storage.positionY[i] = body->transform->position.y;
+    storage.rotation[i] = body->transform->rotation.z;
+    storage.linearVelocityX[i] = body->linearVelocity.x;
+    storage.linearVelocityY[i] = body->linearVelocity.y;
+    storage.angularVelocity[i] = body->angularVelocity;
+}
+
+static void AddChain(World& world, Collider* collider)
+{
+    ColChain& chain = collider->chain;
+    int       count = (int)chain.points.size();
+    assert(count >= (chain.loop ? 3 : 4));
+
+    // An open chain starts at its second point, the first and last are only there as ghosts
+    int first = chain.loop ? 0 : 1;
+    int segmentCount = chain.loop ? count : count - 3;
+
+    for (int i = first; i < first + segmentCount; ++i)
+    {
+        ColSegment segment;
+        segment.ghost1 = chain.points[(i + count - 1) % count];
+        segment.point1 = chain.points[i];
+        segment.point2 = chain.points[(i + 1) % count];
+        segment.ghost2 = chain.points[(i + 2) % count];
+        segment.chain = collider;
+
+        Collider& segmentCollider =
+            world.segments.emplace_back(ColliderType::sm2d_Segment, segment, collider->body);
+        segmentCollider.filter = collider->filter;
+        segmentCollider.sensor = collider->sensor;
+
+        chain.segments.push_back(&segmentCollider);
+        AddCollider(world, &segmentCollider);
+    }
+}
+
+void AddCollider(World& world, Collider* collider)
+{
+    if (collider->body->bodyIndex == -1)
+    {
+        AddBody(world, collider->body);
+    }
+
+    if (collider->type == ColliderType::sm2d_Chain)
+    {
+        AddChain(world, collider);
+        return;
+    }
+
+    world.colliders.push_back(collider);
+    SyncCollider(*collider);
+
+    // Building the static tree in one go gives a better tree than inserting into it
+    if (collider->body->type == BodyType::sm2d_Static)
+    {
+        world.staticTreeDirty = true;
+    }
+    else
+    {
+        InsertLeaf(world.dynamicTree, collider, ColliderToAABB(*collider));
+    }
+}
+
+void UpdateColliders(World& world)
+{
+    if (world.staticTreeDirty)
+    {
+        std::vector<Collider*> staticColliders;
+        for (Collider* collider : world.colliders)
+        {
+            if (collider->body->type == BodyType::sm2d_Static)
+            {
+                staticColliders.push_back(collider);
+            }
+        }
+
+        BuildTree(world.staticTree, staticColliders);
+        world.staticTreeDirty = false;
+    }
+
+    for (Collider* collider : world.colliders)
+    {
+        Rigidbody* body = collider->body;
+        if (body->type == BodyType::sm2d_Static || !body->awake)
+            continue;
+
+        // Bodies that didn't move keep their leaf, apart from bullets whose box covers their sweep
+        if (!SyncCollider(*collider) && !body->bullet)
+            continue;
+
+        AABB box = ColliderToAABB(*collider);
+
+        // Bullets get a box around their whole motion this step, so the broadphase sees everything
+        // they swept through
+        if (body->bullet)
+        {
+            glm::vec2 sweep = body->previousPosition - glm::vec2(body->transform->position);
+            box = AABBUnion(box, AABB(box.upperBound + sweep, box.lowerBound + sweep));
+        }
+
+        RemoveLeaf(world.dynamicTree, collider->treeIndex);
+        InsertLeaf(world.dynamicTree, collider, box);
+    }
+}
+
+void SolveBullets(World& world)
+{
+    for (Collider* collider : world.colliders)
+    {
+        Rigidbody* body = collider->body;
+        if (body->bullet && body->type == BodyType::sm2d_Dynamic && body->awake)
+        {
+            SolveBullet(world, *collider);
+        }
+    }
+}
+
+void GetCollisionsInWorld(World& world)
+{
+    world.pairs.clear();
+    world.contacts.clear();
+
+    GetPairsInTree(world.dynamicTree, world.staticTree, world.pairs);
+    CollidePairs(world, world.pairs, world.contacts);
+}
+
+void StepWorld(World& world, float deltaTime)
+{
+    // The soft step solver integrates the bodies itself between its substeps
+    if (world.settings.solverType != sm2d_SolverSoftStep)
+    {
+        LoadBodies(world, deltaTime);
+        IntegrateBodies(world);
+        StoreBodies(world);
+    }
+
+    UpdateColliders(world);
+    SolveBullets(world);
+    GetCollisionsInWorld(world);
+    SolveContacts(world, deltaTime);
+    UpdateIslands(world, deltaTime);
+}
+
+void StepWorlds(World* const* worlds, int worldCount, float deltaTime)
+{
+    // Each world is a job of its own. The parallel parts of a step queue more jobs on the same
+    // pool, and a thread waiting on them helps with whatever is queued, other worlds included
+    GetThreadPool().ParallelFor(worldCount, 1,
+                                [&](int begin, int end, int)
+                                {
+                                    for (int i = begin; i < end; ++i)
+                                    {
+                                        StepWorld(*worlds[i], deltaTime);
+                                    }
+                                });
+}
+
+void LoadBodies(World& world, float deltaTime)
+{
+    BodyStorage& storage = world.bodies;
+
+    bool timeStepChanged = deltaTime != world.dampingDeltaTime;
+    world.dampingDeltaTime = deltaTime;
+
+    // Only bodies that were added, woken or changed by hand are read from their rigidbodies, the
+    // rest carry on from the state the storage kept since the last step
+    for (int i : storage.dirtyBodies)
+    {
+        Rigidbody* body = storage.bodies[i];
+        body->dirty = false;
+
+        storage.moving[i] = body->type != sm2d_Static && body->awake;
+        if (!storage.moving[i])
+            continue;
+
+        storage.positionX[i] = body->transform->position.x;
+        storage.positionY[i] = body->transform->position.y;
+        storage.rotation[i] = body->transform->rotation.z;
+        storage.linearVelocityX[i] = body->linearVelocity.x;
+        storage.linearVelocityY[i] = body->linearVelocity.y;
+        storage.angularVelocity[i] = body->angularVelocity;
+        storage.forceX[i] = body->force.x;
+        storage.forceY[i] = body->force.y;
+        storage.torque[i] = body->torque;
+        storage.inverseMass[i] = body->mass > 0.0f ? 1.0f / body->mass : 0.0f;
+        storage.inverseInertia[i] = body->fixedRotation || body->momentOfInertia <= 0.0f
+                                        ? 0.0f
+                                        : 1.0f / body->momentOfInertia;
+
+        storage.linearDamping[i] = body->linearDamping;
+        storage.angularDamping[i] = body->angularDamping;
+        storage.linearDampingFactor[i] = std::pow(body->linearDamping, deltaTime);
+        storage.angularDampingFactor[i] = std::pow(body->angularDamping, deltaTime);
+    }
+    storage.dirtyBodies.clear();
+
+    for (int i = 0; i < (int)storage.bodies.size(); ++i)
+    {
+        // Bodies that don't move keep whatever is in their slot, StoreBodies skips them
+        if (!storage.moving[i])
+        {
+            storage.stepTime[i] = 0.0f;
+            continue;
+        }
+
+        storage.stepTime[i] = deltaTime;
+
+        // Bullets sweep from here and the islands measure how far the body moved from here
+        storage.previousPositionX[i] = storage.positionX[i];
+        storage.previousPositionY[i] = storage.positionY[i];
+        storage.previousRotation[i] = storage.rotation[i];
+        storage.deltaPositionX[i] = 0.0f;
+        storage.deltaPositionY[i] = 0.0f;
+        storage.deltaRotation[i] = 0.0f;
+
+        if (timeStepChanged)
+        {
+            storage.linearDampingFactor[i] = std::pow(storage.linearDamping[i], deltaTime);
+            storage.angularDampingFactor[i] = std::pow(storage.angularDamping[i], deltaTime);
+        }
+    }
+}
+
+// Semi-implicit Euler, the SIMD paths below do the same math. Bodies that don't move this step
+// have a step time of zero, so they can go through the same lanes without branching. Their slots
+// may get changed but they're never stored
+
+static void IntegrateVelocityRange(BodyStorage& storage, const glm::vec2& gravity, int begin,
+                                   int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        float h = storage.stepTime[i];
+
+        float vx = storage.linearVelocityX[i] +
+                   (gravity.x + storage.forceX[i] * storage.inverseMass[i]) * h;
+        float vy = storage.linearVelocityY[i] +
+                   (gravity.y + storage.forceY[i] * storage.inverseMass[i]) * h;
+        float w = storage.angularVelocity[i] + storage.torque[i] * storage.inverseInertia[i] * h;
+
+        storage.linearVelocityX[i] = vx * storage.linearDampingFactor[i];
+        storage.linearVelocityY[i] = vy * storage.linearDampingFactor[i];
+        storage.angularVelocity[i] = w * storage.angularDampingFactor[i];
+    }
+}
+
+static void IntegratePositionRange(BodyStorage& storage, int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        float h = storage.stepTime[i];
+
+        float dx = storage.linearVelocityX[i] * h;
+        float dy = storage.linearVelocityY[i] * h;
+        float dr = storage.angularVelocity[i] * h;
+
+        storage.positionX[i] += dx;
+        storage.positionY[i] += dy;
+        storage.rotation[i] += dr;
+        storage.deltaPositionX[i] += dx;
+        storage.deltaPositionY[i] += dy;
+        storage.deltaRotation[i] += dr;
+    }
+}
+
+void IntegrateBodies(World& world)
+{
+    IntegrateVelocities(world);
+    IntegratePositions(world);
+}
+
+void IntegrateVelocities(World& world)
+{
+    BodyStorage& storage = world.bodies;
+
+    int count = (int)storage.bodies.size();
+    int begin = 0;
+
+#ifdef SM_SIMD_X86
+    __m128 gravityX = _mm_set1_ps(world.settings.gravity.x);
+    __m128 gravityY = _mm_set1_ps(world.settings.gravity.y);
+
+    for (; begin + 4 <= count; begin += 4)
+    {
+        int    i = begin;
+        __m128 h = _mm_loadu_ps(&storage.stepTime[i]);
+        __m128 inverseMass = _mm_loadu_ps(&storage.inverseMass[i]);
+        __m128 linearFactor = _mm_loadu_ps(&storage.linearDampingFactor[i]);
+
+        __m128 accelerationX =
+            _mm_add_ps(gravityX, _mm_mul_ps(_mm_loadu_ps(&storage.forceX[i]), inverseMass));
+        __m128 accelerationY =
+            _mm_add_ps(gravityY, _mm_mul_ps(_mm_loadu_ps(&storage.forceY[i]), inverseMass));
+        __m128 angularAcceleration = _mm_mul_ps(_mm_loadu_ps(&storage.torque[i]),
+                                                _mm_loadu_ps(&storage.inverseInertia[i]));
+
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(&storage.linearVelocityX[i]),
+                               _mm_mul_ps(accelerationX, h));
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(&storage.linearVelocityY[i]),
+                               _mm_mul_ps(accelerationY, h));
+        __m128 w = _mm_add_ps(_mm_loadu_ps(&storage.angularVelocity[i]),
+                              _mm_mul_ps(angularAcceleration, h));
+
+        _mm_storeu_ps(&storage.linearVelocityX[i], _mm_mul_ps(vx, linearFactor));
+        _mm_storeu_ps(&storage.linearVelocityY[i], _mm_mul_ps(vy, linearFactor));
+        _mm_storeu_ps(&storage.angularVelocity[i],
+                      _mm_mul_ps(w, _mm_loadu_ps(&storage.angularDampingFactor[i])));
+    }
+#endif
+
+    // Whatever is left over, or every body when there is no SIMD path
+    IntegrateVelocityRange(storage, world.settings.gravity, begin, count);
+}
+
+void IntegratePositions(World& world)
+{
+    BodyStorage& storage = world.bodies;
+
+    int count = (int)storage.bodies.size();
+    int begin = 0;
+
+#ifdef SM_SIMD_X86
+    for (; begin + 4 <= count; begin += 4)
+    {
+        int    i = begin;
+        __m128 h = _mm_loadu_ps(&storage.stepTime[i]);
+
+        __m128 dx = _mm_mul_ps(_mm_loadu_ps(&storage.linearVelocityX[i]), h);
+        __m128 dy = _mm_mul_ps(_mm_loadu_ps(&storage.linearVelocityY[i]), h);
+        __m128 dr = _mm_mul_ps(_mm_loadu_ps(&storage.angularVelocity[i]), h);
+
+        _mm_storeu_ps(&storage.positionX[i], _mm_add_ps(_mm_loadu_ps(&storage.positionX[i]), dx));
+        _mm_storeu_ps(&storage.positionY[i], _mm_add_ps(_mm_loadu_ps(&storage.positionY[i]), dy));
+        _mm_storeu_ps(&storage.rotation[i], _mm_add_ps(_mm_loadu_ps(&storage.rotation[i]), dr));
+        _mm_storeu_ps(&storage.deltaPositionX[i],
+                      _mm_add_ps(_mm_loadu_ps(&storage.deltaPositionX[i]), dx));
+        _mm_storeu_ps(&storage.deltaPositionY[i],
+                      _mm_add_ps(_mm_loadu_ps(&storage.deltaPositionY[i]), dy));
+        _mm_storeu_ps(&storage.deltaRotation[i],
+                      _mm_add_ps(_mm_loadu_ps(&storage.deltaRotation[i]), dr));
+    }
+#endif
+
+    IntegratePositionRange(storage, begin, count);
+}
+
+void StoreBodies(World& world)
+{
+    BodyStorage& storage = world.bodies;
+
+    for (int i = 0; i < (int)storage.bodies.size(); ++i)
+    {
+        if (storage.stepTime[i] == 0.0f)
+            continue;
+
+        Rigidbody* body = storage.bodies[i];
+
+        body->transform->position.x = storage.positionX[i];
+        body->transform->position.y = storage.positionY[i];
+        body->transform->rotation.z = storage.rotation[i];
+
+        body->linearVelocity = glm::vec2(storage.linearVelocityX[i], storage.linearVelocityY[i]);
+        body->angularVelocity = storage.angularVelocity[i];
+        body->previousPosition =
+            glm::vec2(storage.previousPositionX[i], storage.previousPositionY[i]);
+        body->previousRotation = storage.previousRotation[i];
+
+        body->force = glm::vec2(0.0f);
+        body->torque = 0.0f;
+        storage.forceX[i] = 0.0f;
+        storage.forceY[i] = 0.0f;
+        storage.torque[i] = 0.0f;
+
+        body->hasMoved =
+            body->angularVelocity > 0.05f || glm::length(body->linearVelocity) > 0.01f;
+    }
+}
+
+} // namespace sm2d
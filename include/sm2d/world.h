@@ -0,0 +1,186 @@
+#pragma once
+
+#include <sm2d/types.h>
+#include <sm2d/colliders.h>
+#include <sm2d/solver.h>
+#include <deque>
+#include <vector>
+
+namespace sm2d
+{
+
+// The state of every body in packed arrays, Rigidbody::bodyIndex is the body's slot in each one.
+// Keeping every field in its own array lets the integrator run over four bodies at a time. The
+// arrays hold the real state between steps, a body is only read from its rigidbody when it's added,
+// woken or marked dirty, and StoreBodies writes the state back to the rigidbodies after each step
+struct BodyStorage
+{
+    std::vector<Rigidbody*> bodies;
+    std::vector<int>        dirtyBodies; // Slots to read from their rigidbodies before next step
+    std::vector<uint8_t>    moving;      // Awake and not static, the rest get a step time of zero
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> rotation;
+    std::vector<float> linearVelocityX;
+    std::vector<float> linearVelocityY;
+    std::vector<float> angularVelocity;
+    std::vector<float> forceX;
+    std::vector<float> forceY;
+    std::vector<float> torque;
+    std::vector<float> inverseMass;
+    std::vector<float> inverseInertia;
+
+    std::vector<float> linearDamping;        // Damping the linear factor was computed from
+    std::vector<float> angularDamping;       // Damping the angular factor was computed from
+    std::vector<float> linearDampingFactor;  // linearDamping ^ deltaTime
+    std::vector<float> angularDampingFactor; // angularDamping ^ deltaTime
+
+    std::vector<float> stepTime; // The time step for bodies that move this step, zero for the rest
+
+    std::vector<float> deltaPositionX; // How far the body moved since the step started
+    std::vector<float> deltaPositionY;
+    std::vector<float> deltaRotation;
+
+    std::vector<float> previousPositionX; // Where the body was when the step started
+    std::vector<float> previousPositionY;
+    std::vector<float> previousRotation;
+};
+
+enum SolverType
+{
+    sm2d_SolverImpulse = 0,  // One integration and one pass of ResolveCollisions per step
+    sm2d_SolverSoftStep = 1, // Substepped soft contacts, steadier stacks for a bit more work
+};
+
+struct WorldSettings
+{
+    glm::vec2 gravity = glm::vec2(0.0f, -3.5f);
+
+    SolverType solverType = sm2d_SolverImpulse;
+
+    // Soft step solver settings, the contact stiffness is capped at a quarter of the substep rate
+    int   substepCount = 4;            // Velocity and position updates per step
+    float contactHertz = 30.0f;        // Stiffness of contacts
+    float contactDampingRatio = 10.0f; // How much contacts bounce back while pushing bodies apart
+    float contactPushVelocity = 3.0f;  // Fastest overlapping bodies are pushed apart
+    float friction = 0.6f;             // Friction coefficient of every contact
+    float restitutionThreshold = 1.0f; // Contacts slower than this don't bounce
+    bool  warmStarting = true;         // Start contacts off with the impulses they had last step
+};
+
+// Buffers a step fills and empties again, kept so the step doesn't allocate once it's warmed up
+struct StepBuffers
+{
+    std::vector<std::vector<Manifold>> manifolds; // One per range of pairs in the narrowphase
+
+    std::vector<Pair>     solidPairs;  // Pairs without a sensor, when there are sensor pairs
+    std::vector<Pair>     sensorPairs; // Pairs between a sensor and a collider that isn't one
+    std::vector<Manifold> sensorResults;
+
+    std::vector<SensorEvent> previousOverlaps;
+    std::vector<SensorEvent> sortedPrevious;
+    std::vector<SensorEvent> sortedCurrent;
+
+    std::vector<Collider*> bulletCandidates; // Static colliders a bullet's sweep might hit
+
+    // Island building, every awake body gets a union-find slot
+    std::vector<Rigidbody*> islandBodies;
+    std::vector<int>        islandParents;
+    std::vector<float>      islandSleepTimes; // Per root, the shortest sleep time in its island
+    std::vector<int>        islandSlots;      // Per root, the island it's put to sleep in
+};
+
+// A physics world, it owns everything a step touches. Worlds share nothing but the thread pool,
+// so separate worlds can be stepped on different threads at the same time
+struct World
+{
+    BodyStorage   bodies;
+    WorldSettings settings;
+
+    std::vector<Collider*> colliders; // Every collider in the world, in the order they were added
+    std::deque<Collider>   segments;  // Segments made from the chains that were added
+
+    Tree dynamicTree;             // Dynamic and kinematic colliders, reinserted as they move
+    Tree staticTree;              // Static colliders, built in one go and rebuilt when they change
+    bool staticTreeDirty = false; // A static collider was added since the static tree was built
+
+    std::vector<Island> islands; // Sleeping islands, an empty island is a free slot
+
+    std::vector<Pair>     pairs;    // Pairs the broadphase found in the last step
+    std::vector<Manifold> contacts; // Collisions the narrowphase found in the last step
+
+    // Sensor events from the last step, they're replaced every step
+    std::vector<SensorEvent> sensorBeginEvents; // Overlaps that started this step
+    std::vector<SensorEvent> sensorEndEvents;   // Overlaps that ended this step
+    std::vector<SensorEvent> sensorOverlaps;    // Every overlap a sensor has right now
+
+    SolverState solver;
+    StepBuffers buffers;
+
+    float dampingDeltaTime = 0.0f; // Time step the damping factors were computed for
+};
+
+// The world the engine's systems step
+inline World world;
+
+// Gives a rigidbody a slot in the world's body storage
+void AddBody(World& world, Rigidbody* body);
+
+// Has the next step read the body's state from its rigidbody and transform again. Code that
+// changes a body's position, velocity, mass, inertia, damping, type or awake flag by hand between
+// steps has to call this or use one of the setters below, or the world keeps using its own copy
+void MarkBodyDirty(Rigidbody* body);
+
+// Moves a body and marks it dirty
+void SetBodyTransform(Rigidbody* body, const glm::vec2& position, float rotation);
+
+// Sets a body's velocity and marks it dirty
+void SetLinearVelocity(Rigidbody* body, const glm::vec2& velocity);
+void SetAngularVelocity(Rigidbody* body, float velocity);
+
+// Copies a body's position, rotation and velocities into its slot right away, for code that
+// changes them on the rigidbody in the middle of a step like the impulse solver and the bullets
+void CopyBodyToStorage(Rigidbody* body);
+
+// Adds a collider to the world and its body too if it isn't in it yet. Static colliders get put
+// in the static tree the next time the colliders are updated. A chain adds a segment collider for
+// each of its edges instead of itself, they take the chain's filter and sensor flag
+void AddCollider(World& world, Collider* collider);
+
+// Refits the leaves of the colliders that moved since the last step and rebuilds the static tree
+// if static colliders were added. Bullets get a leaf around their whole motion this step
+void UpdateColliders(World& world);
+
+// Sweeps every awake bullet against the static colliders, see SolveBullet
+void SolveBullets(World& world);
+
+// Finds the pairs in the world's trees and runs the narrowphase on them into world.contacts
+void GetCollisionsInWorld(World& world);
+
+// Runs a whole step: integration, the colliders, the bullets, collision detection, the solver and
+// the islands, the same work the engine's systems do for the engine's world each frame
+void StepWorld(World& world, float deltaTime);
+
+// Steps independent worlds at the same time on the sm2d thread pool and returns when they're done
+void StepWorlds(World* const* worlds, int worldCount, float deltaTime);
+
+// Reads the dirty bodies into the world's body storage and gets every moving body ready to be
+// integrated. The damping factors are recomputed for the dirty bodies, and for every body if the
+// time step changed since the last step
+void LoadBodies(World& world, float deltaTime);
+
+// Applies gravity, forces and damping to every awake body and moves it by its velocity
+void IntegrateBodies(World& world);
+
+// Applies gravity, forces and damping to the velocity of every awake body
+void IntegrateVelocities(World& world);
+
+// Moves every awake body by its velocity and adds the motion to its delta position
+void IntegratePositions(World& world);
+
+// Writes the integrated state back to the rigidbodies and their transforms in one pass, and
+// clears the forces that were applied this step. It's the only place the storage is copied out
+void StoreBodies(World& world);
+
+} // namespace sm2d
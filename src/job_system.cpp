@@ -0,0 +1,248 @@
+#include <salmon/job_system.h>
+#include <algorithm>
+
+// Which job system's worker this thread is and the queue it owns, threads that aren't workers use
+// queue zero
+static thread_local const EngineJobSystem* tJobSystem = nullptr;
+static thread_local int                    tQueueIndex = 0;
+
+EngineJobSystem::EngineJobSystem(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        threadCount = std::min((int)std::thread::hardware_concurrency() - 1, (int)cMaxJobWorkers);
+    }
+    threadCount = std::max(threadCount, 0);
+
+    JobSystemWithBarrier::Init(cMaxBarriers);
+    jobPool.Init(cMaxJobs, cMaxJobs);
+
+    for (int i = 0; i <= threadCount; ++i) { queues.push_back(std::make_unique<JobQueue>()); }
+    for (int i = 1; i <= threadCount; ++i)
+    {
+        threads.emplace_back(&EngineJobSystem::WorkerLoop, this, i);
+    }
+}
+
+EngineJobSystem::~EngineJobSystem()
+{
+    quitting = true;
+    queuedJobs.fetch_add(1);
+    queuedJobs.notify_all();
+
+    for (std::thread& thread : threads) { thread.join(); }
+
+    // Finish whatever was still queued so no job is left holding a reference
+    while (RunPendingJob()) {}
+}
+
+int EngineJobSystem::GetRangeCount(int count, int minRange) const
+{
+    if (count <= 0)
+        return 0;
+
+    minRange = std::max(minRange, 1);
+    return std::clamp((count + minRange - 1) / minRange, 1, GetWorkerCount());
+}
+
+void EngineJobSystem::ParallelFor(int count, int minRange,
+                                  const std::function<void(int, int, int)>& task)
+{
+    int rangeCount = GetRangeCount(count, minRange);
+    if (rangeCount == 0)
+        return;
+
+    if (rangeCount == 1)
+    {
+        task(0, count, 0);
+        return;
+    }
+
+    std::atomic<int> remaining = rangeCount - 1;
+
+    for (int i = 1; i < rangeCount; ++i)
+    {
+        int begin = (int)((long long)count * i / rangeCount);
+        int end = (int)((long long)count * (i + 1) / rangeCount);
+        CreateJob("ParallelFor", JPH::Color::sCyan,
+                  [&task, &remaining, begin, end, i]()
+                  {
+                      task(begin, end, i);
+                      remaining.fetch_sub(1, std::memory_order_release);
+                  });
+    }
+
+    // The calling thread takes the first range itself
+    task(0, (int)((long long)count / rangeCount), 0);
+
+    // Help out with whatever is queued instead of blocking, this keeps nested calls from
+    // deadlocking when ParallelFor is called from inside a job
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunPendingJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JPH::JobHandle EngineJobSystem::Schedule(const char* name, const std::function<void()>& task)
+{
+    JPH::JobHandle handle = CreateJob(name, JPH::Color::sGrey, task);
+
+    // Without workers nothing would pick the job up, so it runs right away
+    if (threads.empty())
+    {
+        handle.GetPtr()->Execute();
+    }
+
+    return handle;
+}
+
+void EngineJobSystem::Wait(const JPH::JobHandle& handle)
+{
+    while (!handle.IsDone())
+    {
+        if (!RunPendingJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JPH::JobHandle EngineJobSystem::CreateJob(const char* name, JPH::ColorArg color,
+                                          const JobFunction& function,
+                                          JPH::uint32 dependencyCount)
+{
+    // Wait for a free job if they're all in use, the workers free them as they finish
+    JPH::uint32 index;
+    while (true)
+    {
+        index = jobPool.ConstructObject(name, color, this, function, dependencyCount);
+        if (index != decltype(jobPool)::cInvalidObjectIndex)
+            break;
+
+        if (!RunPendingJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    Job* job = &jobPool.Get(index);
+
+    // The handle keeps the job alive, it can finish as soon as it's queued
+    JPH::JobHandle handle(job);
+    if (dependencyCount == 0)
+    {
+        QueueJob(job);
+    }
+
+    return handle;
+}
+
+void EngineJobSystem::QueueJob(Job* job)
+{
+    QueueJobs(&job, 1);
+}
+
+void EngineJobSystem::QueueJobs(Job** jobs, JPH::uint jobCount)
+{
+    // Without workers the barrier that the jobs belong to runs them when it's waited on
+    if (threads.empty())
+        return;
+
+    JobQueue& queue = *queues[GetQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (JPH::uint i = 0; i < jobCount; ++i)
+        {
+            // The queue holds a reference until the job has run
+            jobs[i]->AddRef();
+            queue.jobs.push_back(jobs[i]);
+        }
+        queuedJobs.fetch_add((int)jobCount);
+    }
+
+    if (jobCount == 1)
+        queuedJobs.notify_one();
+    else
+        queuedJobs.notify_all();
+}
+
+void EngineJobSystem::FreeJob(Job* job)
+{
+    jobPool.DestructObject(job);
+}
+
+bool EngineJobSystem::RunPendingJob()
+{
+    Job* job = TakeJob(GetQueueIndex());
+    if (job == nullptr)
+        return false;
+
+    // Jobs that are also in a barrier may have been run by it already, then this does nothing
+    job->Execute();
+    job->Release();
+    return true;
+}
+
+int EngineJobSystem::GetQueueIndex() const
+{
+    return tJobSystem == this ? tQueueIndex : 0;
+}
+
+EngineJobSystem::Job* EngineJobSystem::TakeJob(int queueIndex)
+{
+    // The newest job in our own queue is the one most likely to still be in the cache
+    {
+        JobQueue&                   queue = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            Job* job = queue.jobs.back();
+            queue.jobs.pop_back();
+            queuedJobs.fetch_sub(1);
+            return job;
+        }
+    }
+
+    // Otherwise steal the oldest job from the next queue that has one
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        JobQueue&                   queue = *queues[(queueIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            Job* job = queue.jobs.front();
+            queue.jobs.pop_front();
+            queuedJobs.fetch_sub(1);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void EngineJobSystem::WorkerLoop(int queueIndex)
+{
+    tJobSystem = this;
+    tQueueIndex = queueIndex;
+
+    while (true)
+    {
+        if (RunPendingJob())
+            continue;
+
+        if (quitting)
+            return;
+
+        // Sleep until something gets queued
+        queuedJobs.wait(0);
+    }
+}
+
+EngineJobSystem& GetJobSystem()
+{
+    static EngineJobSystem jobSystem;
+    return jobSystem;
+}
@@ -14,8 +14,10 @@ int main(int argc, char** argv)
     Window window("Prism", SCR_WIDTH, SCR_HEIGHT);
     // glfwSwapInterval(1);
 
-    unsigned int groundTex = Utils::LoadTexture("res/textures/background.png");
-    unsigned int slugariusTex = Utils::LoadTexture("res/textures/Slugarius.png");
+    std::vector<unsigned int> textures;
+    Utils::LoadTextures({"res/textures/background.png", "res/textures/Slugarius.png"}, textures);
+    unsigned int groundTex = textures[0];
+    unsigned int slugariusTex = textures[1];
 
     Scene scene;
 
@@ -71,8 +73,6 @@ int main(int argc, char** argv)
 
     sm2d::Collider* col2 = engineState.scene.Get<sm2d::Collider>(sprite);
 
-    std::vector<sm2d::Manifold> colResults;
-
     // Main loop
     // -----------
     while (!window.ShouldClose())
@@ -85,32 +85,24 @@ int main(int argc, char** argv)
         // ---
         if (Input::GetKey(Key::Left))
         {
-            col2->body->hasMoved = true;
-            col2->body->awake = true;
-            col2->body->force.x -= 20.0f;
+            sm2d::ApplyForce(col2->body, glm::vec2(-20.0f, 0.0f));
         }
         if (Input::GetKey(Key::Right))
         {
-            col2->body->hasMoved = true;
-            col2->body->awake = true;
-            col2->body->force.x += 20.0f;
+            sm2d::ApplyForce(col2->body, glm::vec2(20.0f, 0.0f));
         }
         if (Input::GetKey(Key::Up))
         {
-            col2->body->hasMoved = true;
-            col2->body->awake = true;
-            col2->body->force.y += 20.0f;
+            sm2d::ApplyForce(col2->body, glm::vec2(0.0f, 20.0f));
         }
         if (Input::GetKey(Key::Down))
         {
-            col2->body->hasMoved = true;
-            col2->body->awake = true;
-            col2->body->force.y -= 20.0f;
+            sm2d::ApplyForce(col2->body, glm::vec2(0.0f, -20.0f));
         }
 
-        colResults.clear();
-        sm2d::GetCollisionsInTree(sm2d::bvh, colResults);
-        sm2d::ResolveCollisions(sm2d::bvh, colResults);
+        sm2d::GetCollisionsInWorld(sm2d::world);
+        sm2d::SolveContacts(sm2d::world, engineState.deltaTime);
+        sm2d::UpdateIslands(sm2d::world, engineState.deltaTime);
 
         // End of frame
         ImGuiLayer::EndFrame();
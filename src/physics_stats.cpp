@@ -0,0 +1,118 @@
+#include <salmon/physics.h>
+#include <imgui/imgui.h>
+#include <cstdio>
+
+// A bar that fills up as the capacity gets used and turns red past cCapacityWarningFraction
+static void CapacityBar(const char* name, uint64_t used, uint64_t capacity)
+{
+    float fraction = capacity > 0 ? (float)used / (float)capacity : 0.0f;
+
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "%llu / %llu", (unsigned long long)used,
+                  (unsigned long long)capacity);
+
+    bool nearCapacity = fraction >= cCapacityWarningFraction;
+    if (nearCapacity)
+    {
+        ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+    }
+
+    ImGui::ProgressBar(fraction, ImVec2(-150.0f, 0.0f), overlay);
+    ImGui::SameLine();
+    ImGui::TextUnformatted(name);
+
+    if (nearCapacity)
+    {
+        ImGui::PopStyleColor();
+    }
+}
+
+void PhysicsStatsWindow(bool* open)
+{
+    if (!ImGui::Begin("Physics Stats", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    const PhysicsStats& stats = physicsStats;
+
+    ImGui::Text("Step %llu", (unsigned long long)stats.steps);
+    ImGui::Text("Active bodies: %u of %u", stats.activeBodies, stats.bodies);
+
+    ImGui::SeparatorText("Capacity");
+    CapacityBar("Bodies", stats.bodies, physicsSystem.GetMaxBodies());
+    CapacityBar("Body pairs", stats.bodyPairs, cMaxBodyPairs);
+    CapacityBar("Contact constraints", stats.contactConstraints, cMaxContactConstraints);
+    CapacityBar("Temp allocator", stats.tempPeak, tempAllocator->GetSize());
+    ImGui::Text("Temp allocator peak ever: %.1f MB", stats.tempPeakEver / (1024.0 * 1024.0));
+
+    if (stats.tempFallbacks > 0)
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%u temp allocations went to the heap",
+                           stats.tempFallbacks);
+    }
+
+    if (stats.overflowErrors != 0)
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+                           "Jolt dropped contacts, a buffer overflowed (errors 0x%x)",
+                           stats.overflowErrors);
+    }
+
+    ImGui::SeparatorText("Time");
+    ImGui::Text("Step:        %.3f ms", stats.stepMs);
+    ImGui::Text("Contacts:    %.3f ms", stats.contactsMs);
+    ImGui::Text("Sync:        %.3f ms", stats.syncMs);
+    ImGui::Text("Add bodies:  %.3f ms", stats.addBodiesMs);
+
+    // Counting the layers goes through every body, which is fine while the window is open
+    PhysicsLayerStats layers = GetPhysicsLayerStats();
+
+    ImGui::SeparatorText("Layers");
+    if (ImGui::BeginTable("Object layers", 3, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Object layer");
+        ImGui::TableSetupColumn("Bodies");
+        ImGui::TableSetupColumn("Active");
+        ImGui::TableHeadersRow();
+
+        for (JPH::ObjectLayer layer = 0; layer < Layers::NUM_LAYERS; ++layer)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(cObjectLayerNames[layer]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", layers.objectLayerBodies[layer]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", layers.objectLayerActiveBodies[layer]);
+        }
+
+        ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("Broadphase layers", 2, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Broadphase layer");
+        ImGui::TableSetupColumn("Bodies");
+        ImGui::TableHeadersRow();
+
+        for (JPH::uint layer = 0; layer < BroadPhaseLayers::NUM_LAYERS; ++layer)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(cBroadPhaseLayerNames[layer]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", layers.broadPhaseLayerBodies[layer]);
+        }
+
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Dump to physics_stats.json"))
+    {
+        DumpPhysicsStats("physics_stats.json");
+    }
+
+    ImGui::End();
+}
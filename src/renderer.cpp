@@ -137,16 +137,7 @@ void RenderModel(EntityID ent, const glm::mat4& projection, const glm::mat4& vie
     auto trans = engineState.scene.Get<Transform>(ent);
     auto model = engineState.scene.Get<MeshRenderer>(ent);
 
-    glm::mat4 transform;
-
-    if (trans->useMatrix == false)
-    {
-        transform = MakeModelTransform(trans);
-    }
-    else
-    {
-        transform = trans->modelMat;
-    }
+    glm::mat4 transform = MakeModelTransform(trans);
 
     // Activate the shader program
     defaultShader.use();
@@ -204,6 +195,11 @@ void RenderModel(EntityID ent, const glm::mat4& projection, const glm::mat4& vie
 
 glm::mat4 MakeModelTransform(Transform* trans)
 {
+    if (trans->useMatrix)
+    {
+        return trans->modelMat;
+    }
+
     glm::mat4 transform = glm::mat4(1.0f);
 
     // Matrix multiplication to calculate the transform
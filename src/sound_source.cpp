@@ -1,6 +1,7 @@
 #include <salmon/sound_source.h>
+#include <salmon/ecs.h>
+#include <algorithm>
 #include <iostream>
-#include <thread>
 
 SoundSource::SoundSource()
 {
@@ -28,25 +29,25 @@ void SoundSource::Play(const Sound sound)
 
     alSourcePlay(p_Source);
 
-    // Capture 'this' in a weak_ptr to ensure the object isn't destructed prematurely
-    std::weak_ptr<SoundSource> weakSelf = shared_from_this();
-    std::thread playbackThread(
-        [weakSelf]()
-        {
-            if (auto self = weakSelf.lock())
-            {
-                self->MonitorPlayback();
-            }
-        });
-    playbackThread.detach();
+    // Polled once a frame by SoundSourceSys instead of by a thread per sound
+    std::shared_ptr<SoundSource> self = shared_from_this();
+    if (std::find(playingSources.begin(), playingSources.end(), self) == playingSources.end())
+    {
+        playingSources.push_back(self);
+    }
 }
 
-void SoundSource::MonitorPlayback()
+bool SoundSource::IsPlaying() const
 {
-    ALint state = AL_PLAYING;
-    while (state == AL_PLAYING && alGetError() == AL_NO_ERROR)
-    {
-        alGetSourcei(p_Source, AL_SOURCE_STATE, &state);
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Sleep to avoid busy-waiting
-    }
+    ALint state = AL_STOPPED;
+    alGetSourcei(p_Source, AL_SOURCE_STATE, &state);
+    return state == AL_PLAYING && alGetError() == AL_NO_ERROR;
 }
+
+void SoundSourceSys()
+{
+    std::erase_if(playingSources, [](const std::shared_ptr<SoundSource>& source)
+                  { return !source->IsPlaying(); });
+}
+
+REGISTER_SYSTEM(SoundSourceSys);
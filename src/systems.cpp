@@ -1,6 +1,7 @@
 #include <salmon/components.h>
 #include <salmon/ecs.h>
 #include <salmon/engine.h>
+#include <salmon/job_system.h>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/ext.hpp>
 #include <iostream>
@@ -60,155 +61,255 @@ void SpriteRendererSys()
     }
 }
 
-void RigidBody3DStartSys()
+// Creates the Jolt body of a rigidbody without adding it to the physics system, returns nullptr if
+// the collider type isn't implemented or Jolt ran out of bodies. Mesh colliders take their mesh
+// from the mesh renderer
+static JPH::Body* CreateRigidBody3D(RigidBody3D* rigid, Transform* trans,
+                                    MeshRenderer* meshRenderer)
 {
-    for (EntityID ent : SceneView<Transform, RigidBody3D>(
-             engineState.scene)) // Loops over all entities with transform and rigidbody components
+    JPH::Vec3 transPosition(trans->position.x, trans->position.y, trans->position.z);
+    JPH::RVec3 RtransPosition = transPosition;
+
+    if (rigid->colliderType == ColliderType::Box)
     {
-        auto rigid = engineState.scene.Get<RigidBody3D>(ent);
-        auto trans = engineState.scene.Get<Transform>(ent);
+        JPH::Vec3 bodyScale(rigid->boxSize.x, rigid->boxSize.y, rigid->boxSize.z);
 
-        if (rigid->body != nullptr)
-        {
-            continue;
-        }
+        // Boxes of the same size share a shape
+        JPH::ShapeRefC floor_shape = GetBoxShape(bodyScale);
+        if (floor_shape == nullptr)
+            return nullptr;
 
-        JPH::Vec3 transPosition(trans->position.x, trans->position.y, trans->position.z);
-        JPH::RVec3 RtransPosition = transPosition;
+        // Step 1: Convert Euler angles to GLM quaternion
+        glm::quat glmQuat = glm::quat(trans->rotation);
 
-        if (rigid->colliderType == ColliderType::Box)
-        {
-            JPH::Vec3 bodyScale(rigid->boxSize.x, rigid->boxSize.y, rigid->boxSize.z);
-
-            JPH::BoxShapeSettings floor_shape_settings(bodyScale);
-            floor_shape_settings.SetEmbedded();
-
-            // Create the shape
-            JPH::ShapeSettings::ShapeResult floor_shape_result = floor_shape_settings.Create();
-            JPH::ShapeRefC floor_shape = floor_shape_result.Get(); // We don't expect an error here, but you can check
-                                                                   // floor_shape_result for HasError() / GetError()
-
-            // Step 1: Convert Euler angles to GLM quaternion
-            glm::quat glmQuat = glm::quat(trans->rotation);
-
-            // Step 2: Convert GLM quaternion to Jolt quaternion
-            JPH::Quat joltQuat(glmQuat.x, glmQuat.y, glmQuat.z, glmQuat.w); // Jolt uses (x, y, z, w) order
-
-            // Create the settings for the body itself. Note that here you can also set other properties like the
-            // restitution / friction.
-            JPH::BodyCreationSettings floor_settings(
-                floor_shape, RtransPosition, joltQuat,
-                rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
-                rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
-
-            floor_settings.mCollisionGroup.SetGroupID(rigid->groupID);
-            // Create the actual rigid body
-            rigid->body =
-                bodyInterface.CreateBody(floor_settings); // Note that if we run out of bodies this can return nullptr
-
-            // Add it to the world
-            if (rigid->body != nullptr)
-            {
-                bodyInterface.AddBody(rigid->body->GetID(), JPH::EActivation::Activate);
-            }
-        }
-        else if (rigid->colliderType == ColliderType::Capsule)
-        {
-            float radius = rigid->capsuleRadius;
-            float height = rigid->capsuleHeight;
+        // Step 2: Convert GLM quaternion to Jolt quaternion
+        JPH::Quat joltQuat(glmQuat.x, glmQuat.y, glmQuat.z, glmQuat.w); // Jolt uses (x, y, z, w) order
+
+        // Create the settings for the body itself. Note that here you can also set other properties like the
+        // restitution / friction.
+        JPH::BodyCreationSettings floor_settings(
+            floor_shape, RtransPosition, joltQuat,
+            rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
+            rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
+
+        floor_settings.mCollisionGroup.SetGroupID(rigid->groupID);
+        // Create the actual rigid body
+        JPH::Body* body =
+            bodyInterface.CreateBody(floor_settings); // Note that if we run out of bodies this can return nullptr
+
+        return body;
+    }
+    else if (rigid->colliderType == ColliderType::Capsule)
+    {
+        float radius = rigid->capsuleRadius;
+        float height = rigid->capsuleHeight;
+
+        // Capsule is defined by its half height (distance between the centers of the hemispheres)
+        JPH::ShapeRefC capsule_shape = GetCapsuleShape(height * 0.5f, radius);
+        if (capsule_shape == nullptr)
+            return nullptr;
 
-            // Capsule is defined by its half height (distance between the centers of the hemispheres)
-            JPH::CapsuleShapeSettings capsule_shape_settings(height * 0.5f, radius);
-            capsule_shape_settings.SetEmbedded();
+        // Step 1: Convert Euler angles to GLM quaternion
+        glm::quat glmQuat = glm::quat(trans->rotation);
 
-            // Step 1: Convert Euler angles to GLM quaternion
-            glm::quat glmQuat = glm::quat(trans->rotation);
+        // Step 2: Convert GLM quaternion to Jolt quaternion
+        JPH::Quat joltQuat(glmQuat.x, glmQuat.y, glmQuat.z, glmQuat.w); // Jolt uses (x, y, z, w) order
 
-            // Step 2: Convert GLM quaternion to Jolt quaternion
-            JPH::Quat joltQuat(glmQuat.x, glmQuat.y, glmQuat.z, glmQuat.w); // Jolt uses (x, y, z, w) order
+        JPH::BodyCreationSettings capsule_settings(
+            capsule_shape, RtransPosition, joltQuat,
+            rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
+            rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
 
-            // Create the shape
-            JPH::ShapeSettings::ShapeResult capsule_shape_result = capsule_shape_settings.Create();
-            JPH::ShapeRefC capsule_shape = capsule_shape_result.Get();
+        capsule_settings.mCollisionGroup.SetGroupID(rigid->groupID);
+        // Create the actual rigid body
+        JPH::Body* body = bodyInterface.CreateBody(capsule_settings);
 
-            JPH::BodyCreationSettings capsule_settings(
-                capsule_shape, RtransPosition, joltQuat,
-                rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
-                rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
+        return body;
+    }
+    else if (rigid->colliderType == ColliderType::Sphere)
+    {
+        float radius = rigid->sphereRadius; // Define sphere radius in RigidBody3D
 
-            capsule_settings.mCollisionGroup.SetGroupID(rigid->groupID);
-            // Create the actual rigid body
-            rigid->body = bodyInterface.CreateBody(capsule_settings);
+        // Sphere is defined by its radius
+        JPH::ShapeRefC sphere_shape = GetSphereShape(radius);
+        if (sphere_shape == nullptr)
+            return nullptr;
 
-            // Add it to the world
-            if (rigid->body != nullptr)
-            {
-                bodyInterface.AddBody(rigid->body->GetID(), JPH::EActivation::Activate);
-            }
+        JPH::BodyCreationSettings sphere_settings(
+            sphere_shape, RtransPosition, JPH::Quat::sIdentity(),
+            rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
+            rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
+
+        sphere_settings.mCollisionGroup.SetGroupID(rigid->groupID);
+        // Create the actual rigid body
+        JPH::Body* body = bodyInterface.CreateBody(sphere_settings);
+
+        return body;
+    }
+    else if (rigid->colliderType == ColliderType::Mesh)
+    {
+        if (meshRenderer == nullptr)
+        {
+            std::cerr << "ERROR: Mesh collider needs a mesh renderer to take its mesh from"
+                      << std::endl;
+            return nullptr;
         }
-        else if (rigid->colliderType == ColliderType::Sphere)
+
+        // Mesh shapes have no volume so Jolt can't simulate them as dynamic bodies
+        if (rigid->state == BodyState::Dynamic)
         {
-            float radius = rigid->sphereRadius; // Define sphere radius in RigidBody3D
-
-            // Sphere is defined by its radius
-            JPH::SphereShapeSettings sphere_shape_settings(radius);
-            sphere_shape_settings.SetEmbedded();
-
-            // Create the shape
-            JPH::ShapeSettings::ShapeResult sphere_shape_result = sphere_shape_settings.Create();
-            JPH::ShapeRefC sphere_shape = sphere_shape_result.Get();
-
-            JPH::BodyCreationSettings sphere_settings(
-                sphere_shape, RtransPosition, JPH::Quat::sIdentity(),
-                rigid->state == BodyState::Dynamic ? JPH::EMotionType::Dynamic : JPH::EMotionType::Static,
-                rigid->state == BodyState::Dynamic ? Layers::MOVING : Layers::NON_MOVING);
-
-            sphere_settings.mCollisionGroup.SetGroupID(rigid->groupID);
-            // Create the actual rigid body
-            rigid->body = bodyInterface.CreateBody(sphere_settings);
-
-            // Add it to the world
-            if (rigid->body != nullptr)
-            {
-                bodyInterface.AddBody(rigid->body->GetID(), JPH::EActivation::Activate);
-            }
+            std::cerr << "WARNING: Mesh colliders can only be static" << std::endl;
+            rigid->state = BodyState::Static;
         }
-        else
+
+        const Model& model = meshRenderer->model;
+        float cellSize = glm::max(rigid->meshWeldDistance, rigid->meshDecimation);
+
+        // Loaded from the cooked mesh cache if the model has been used before
+        JPH::ShapeRefC mesh_shape =
+            GetMeshShape(model.path, model.colliderVertices, model.colliderIndices, cellSize);
+        if (mesh_shape == nullptr)
+            return nullptr;
+
+        // The mesh is in model space, so it's scaled the same way the model is when it's rendered
+        if (trans->scale != glm::vec3(1.0f))
         {
-            std::cerr << "ERROR: Collider type not implemented or is null" << std::endl;
+            JPH::Vec3 scale(trans->scale.x, trans->scale.y, trans->scale.z);
+            mesh_shape = new JPH::ScaledShape(mesh_shape, scale);
         }
+
+        glm::quat glmQuat = glm::quat(trans->rotation);
+        JPH::Quat joltQuat(glmQuat.x, glmQuat.y, glmQuat.z, glmQuat.w);
+
+        JPH::BodyCreationSettings mesh_settings(mesh_shape, RtransPosition, joltQuat,
+                                                JPH::EMotionType::Static, Layers::NON_MOVING);
+
+        mesh_settings.mCollisionGroup.SetGroupID(rigid->groupID);
+        JPH::Body* body = bodyInterface.CreateBody(mesh_settings);
+
+        return body;
+    }
+    else
+    {
+        std::cerr << "ERROR: Collider type not implemented or is null" << std::endl;
     }
+
+    return nullptr;
 }
 
-void RigidBody3DSys()
+// Creates the bodies of the rigidbodies that don't have one yet and queues them to be added
+static void CreateNewRigidBodies()
 {
-    for (EntityID ent : SceneView<RigidBody3D>(engineState.scene))
+    for (EntityID ent : SceneView<Transform, RigidBody3D>(
+             engineState.scene)) // Loops over all entities with transform and rigidbody components
     {
         auto rigid = engineState.scene.Get<RigidBody3D>(ent);
+        auto trans = engineState.scene.Get<Transform>(ent);
 
-        if (rigid->state == BodyState::Static)
+        if (rigid->body != nullptr)
         {
             continue;
         }
 
-        JPH::RVec3 positionOfSphere = bodyInterface.GetCenterOfMassPosition(rigid->body->GetID());
+        auto meshRenderer = engineState.scene.Get<MeshRenderer>(ent);
+
+        rigid->body = CreateRigidBody3D(rigid, trans, meshRenderer);
+        if (rigid->body != nullptr)
+        {
+            rigid->body->SetUserData(ent);
+            QueueBodyAdd(rigid->body);
+        }
+    }
+}
+
+void RigidBody3DStartSys()
+{
+    CreateNewRigidBodies();
+
+    // The whole scene goes in as one batch, then the broadphase is rebuilt around it
+    AddPendingBodies(true);
+}
+
+// Copies a body's position and rotation into the transform of its entity
+static void SyncRigidBody3D(const JPH::Body* body)
+{
+    // Bodies of rigidbodies keep their entity in their user data
+    EntityID    ent = (EntityID)body->GetUserData();
+    EntityIndex index = GetEntityIndex(ent);
+    if (index >= engineState.scene.entities.size() || engineState.scene.entities[index].id != ent)
+    {
+        return;
+    }
+
+    auto rigid = engineState.scene.Get<RigidBody3D>(ent);
+    auto trans = engineState.scene.Get<Transform>(ent);
+    if (rigid == nullptr || trans == nullptr || rigid->body != body)
+    {
+        return;
+    }
+
+    JPH::RVec3 position = body->GetPosition();
+    JPH::Quat  rotation = body->GetRotation();
 
-        JPH::Quat rotationOfSphere = bodyInterface.GetRotation(rigid->body->GetID());
+    // Sync position and rotation with Jolt Physics
+    trans->position = glm::vec3(position.GetX(), position.GetY(), position.GetZ()) + rigid->offset;
+    trans->orientation =
+        glm::quat(rotation.GetW(), rotation.GetX(), rotation.GetY(), rotation.GetZ());
 
-        float x = rotationOfSphere.GetX();
-        float y = rotationOfSphere.GetY();
-        float z = rotationOfSphere.GetZ();
-        float w = rotationOfSphere.GetW();
-        // Sync box position and rotation with Jolt Physics
-        engineState.scene.Get<Transform>(ent)->position =
-            glm::vec3(positionOfSphere.GetX() + rigid->offset.x, positionOfSphere.GetY() + rigid->offset.y,
-                      positionOfSphere.GetZ() + rigid->offset.z);
+    // The rotation goes straight into the model matrix instead of through Euler angles
+    trans->modelMat = glm::translate(glm::mat4(1.0f), trans->position) *
+                      glm::mat4_cast(trans->orientation) *
+                      glm::scale(glm::mat4(1.0f), trans->scale);
+    trans->useMatrix = true;
+}
+
+void RigidBody3DSys()
+{
+    // Rigidbodies assigned after startup are picked up here and added together once a frame
+    CreateNewRigidBodies();
+    AddPendingBodies(false);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Only awake bodies can have moved, and nothing else uses the physics system while the systems
+    // run, so the active bodies are read without copying the list or locking them
+    const JPH::BodyLockInterfaceNoLock& bodies = physicsSystem.GetBodyLockInterfaceNoLock();
+
+    JPH::EBodyType     type = JPH::EBodyType::RigidBody;
+    const JPH::BodyID* activeBodies = physicsSystem.GetActiveBodiesUnsafe(type);
+    JPH::uint32        activeCount = physicsSystem.GetNumActiveBodies(type);
+
+    for (JPH::uint32 i = 0; i < activeCount; ++i)
+    {
+        const JPH::Body* body = bodies.TryGetBody(activeBodies[i]);
+        if (body != nullptr)
+        {
+            SyncRigidBody3D(body);
+        }
+    }
 
-        glm::quat quatRotation(-z, y, x, w);
-        glm::vec3 eulerRotation = glm::eulerAngles(quatRotation); // Converts quaternion to Euler angles
+    physicsStats.syncMs = MillisecondsSince(start);
+}
 
-        engineState.scene.Get<Transform>(ent)->rotation = eulerRotation;
+bool RestoreSnapshot(uint64_t id)
+{
+    const PhysicsSnapshot* snapshot = RestorePhysicsSnapshot(id);
+    if (snapshot == nullptr)
+        return false;
+
+    // Sleeping bodies can have moved too, so every body in the snapshot is synced and not just the
+    // active ones
+    const JPH::BodyLockInterfaceNoLock& bodies = physicsSystem.GetBodyLockInterfaceNoLock();
+    for (JPH::BodyID bodyID : snapshot->bodies)
+    {
+        const JPH::Body* body = bodies.TryGetBody(bodyID);
+        if (body != nullptr)
+        {
+            SyncRigidBody3D(body);
+        }
     }
+
+    return true;
 }
 
 void LightStartSys()
@@ -287,15 +388,29 @@ void AnimatorStartSys()
 
 void AnimatorSys()
 {
+    static std::vector<Animator*> playing;
+    playing.clear();
+
     for (EntityID ent : SceneView<Animator>(engineState.scene))
     {
         auto anim = engineState.scene.Get<Animator>(ent);
 
         if (anim->playing)
         {
-            UpdateAnimation(engineState.deltaTime * anim->speed, anim);
+            playing.push_back(anim);
         }
     }
+
+    // Every animator writes only its own bone matrices, and a skeleton is enough work for a job
+    GetJobSystem().ParallelFor((int)playing.size(), 1,
+                               [](int begin, int end, int)
+                               {
+                                   for (int i = begin; i < end; ++i)
+                                   {
+                                       UpdateAnimation(engineState.deltaTime * playing[i]->speed,
+                                                       playing[i]);
+                                   }
+                               });
 }
 
 float lastFrame = 0.0f;
@@ -1,5 +1,6 @@
 #include <salmon/utils.h>
 #include <salmon/stb_image.h>
+#include <salmon/job_system.h>
 #include <glad/glad.h>
 #include <iostream>
 #include <random>
@@ -7,48 +8,88 @@
 namespace Utils
 {
 
-unsigned int LoadTexture(const char* path)
+// An image decoded by stb_image, waiting to be uploaded
+struct DecodedImage
 {
-    stbi_set_flip_vertically_on_load(true);
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    unsigned char* data = nullptr;
+    int            width = 0;
+    int            height = 0;
+    int            components = 0;
+};
 
-    int            width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-                        format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-                        format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-        glBindTexture(GL_TEXTURE_2D, 0);
-        stbi_image_free(data);
-    }
-    else
+// Reads and decodes the file without touching OpenGL, so it can run on any thread
+static DecodedImage DecodeImage(const char* path)
+{
+    DecodedImage image;
+    image.data = stbi_load(path, &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+// Uploads a decoded image and frees it, this has to run on the thread with the OpenGL context
+static unsigned int UploadTexture(DecodedImage& image, const char* path)
+{
+    if (!image.data)
     {
         std::cout << "Texture failed to load at path: " << path << '\n';
-        stbi_image_free(data);
         return LoadTexture("res/textures/MissingTexture.png");
     }
 
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    GLenum format;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE,
+                 image.data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                    format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                    format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    stbi_image_free(image.data);
+    image.data = nullptr;
+
     return textureID;
 }
 
+unsigned int LoadTexture(const char* path)
+{
+    stbi_set_flip_vertically_on_load(true);
+    DecodedImage image = DecodeImage(path);
+    return UploadTexture(image, path);
+}
+
+void LoadTextures(const std::vector<const char*>& paths, std::vector<unsigned int>& textures)
+{
+    // The flip flag is global in stb_image, so it's set once before the workers start decoding
+    stbi_set_flip_vertically_on_load(true);
+
+    std::vector<DecodedImage> images(paths.size());
+    GetJobSystem().ParallelFor((int)paths.size(), 1,
+                               [&](int begin, int end, int)
+                               {
+                                   for (int i = begin; i < end; ++i)
+                                   {
+                                       images[i] = DecodeImage(paths[i]);
+                                   }
+                               });
+
+    textures.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) { textures[i] = UploadTexture(images[i], paths[i]); }
+}
+
 template<typename T> int IndexInVec(std::vector<T>& v, T& K)
 {
     auto it = std::find(v.begin(), v.end(), K);